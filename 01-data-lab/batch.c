@@ -0,0 +1,293 @@
+/*
+ * CS:APP Data Lab
+ *
+ * batch.c - Array forms of some of the puzzles in bits.c
+ *
+ * The generic loops use only branch-free integer operations, with
+ * comparisons that become masks or selects, so that the compiler can
+ * vectorize them for whatever target it was given. Where the CPU has
+ * AVX2, explicit versions handle eight values at a time, and the
+ * generic loops only the last few.
+ */
+#include "batch.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#define BATCH_AVX2
+#endif
+
+/* Whether the AVX2 versions are used: -1 until first checked */
+static int use_simd = -1;
+
+/*******************************************
+ * Branch-free scalar forms, for any target
+ *******************************************/
+
+/* Halve the magnitude bits by a binary search, as bits.c does. Each
+   shift is by a constant, selected, which vectorizes without per-lane
+   variable shifts. */
+static inline int howManyBits_one(int x)
+{
+    unsigned y = x ^ (x >> 31);
+    int b16, b8, b4, b2, b1;
+
+    b16 = y > 0xFFFF;
+    y = b16 ? y >> 16 : y;
+    b8 = y > 0xFF;
+    y = b8 ? y >> 8 : y;
+    b4 = y > 0xF;
+    y = b4 ? y >> 4 : y;
+    b2 = y > 0x3;
+    y = b2 ? y >> 2 : y;
+    b1 = y > 0x1;
+    y = b1 ? y >> 1 : y;
+    return (b16 << 4) + (b8 << 3) + (b4 << 2) + (b2 << 1) + b1 + y + 1;
+}
+
+/* A denorm shifts its fraction into the exponent; a norm that overflows
+   becomes infinity; NaN and infinity are returned as they are */
+static inline unsigned floatScale2_one(unsigned uf)
+{
+    unsigned exp = uf & 0x7F800000;
+    unsigned denorm = (uf & 0x80000000) | (uf << 1);
+    unsigned norm = uf + 0x00800000;
+    unsigned inf = -((norm & 0x7F800000) == 0x7F800000);
+
+    norm &= ~(inf & 0x007FFFFF);
+    return exp == 0 ? denorm : exp == 0x7F800000 ? uf : norm;
+}
+
+/* Both shifts are built from selected constant shifts, one per bit of
+   their counts, and one of them kept */
+static inline int floatFloat2Int_one(unsigned uf)
+{
+    int exp = ((uf >> 23) & 0xFF) - 127;
+    unsigned frac = (uf & 0x7FFFFF) | 0x800000;
+    int sign = (int) uf >> 31;
+    int up = exp - 23;
+    int down = up < -31 ? 31 : -up;
+    unsigned left = frac, right = frac, val;
+
+    left = up & 4 ? left << 4 : left;
+    left = up & 2 ? left << 2 : left;
+    left = up & 1 ? left << 1 : left;
+    right = down & 16 ? right >> 16 : right;
+    right = down & 8 ? right >> 8 : right;
+    right = down & 4 ? right >> 4 : right;
+    right = down & 2 ? right >> 2 : right;
+    right = down & 1 ? right >> 1 : right;
+    val = up > 0 ? left : right;
+    val = (val ^ sign) - sign;
+    return exp > 30 ? (int) 0x80000000 : (int) val;
+}
+
+/*******************
+ * AVX2 versions
+ *******************/
+
+#ifdef BATCH_AVX2
+/* Each returns how many values it did: a multiple of 8 */
+
+__attribute__((target("avx2")))
+static int howManyBits_avx2(const int *x, int *out, int n)
+{
+    __m256i v, y, b16, b8, b4, b2, b1, sum;
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+	v = _mm256_loadu_si256((const __m256i *) (x + i));
+	y = _mm256_xor_si256(v, _mm256_srai_epi32(v, 31));
+	b16 = _mm256_and_si256(_mm256_cmpgt_epi32(y, _mm256_set1_epi32(0xFFFF)),
+			       _mm256_set1_epi32(16));
+	y = _mm256_srlv_epi32(y, b16);
+	b8 = _mm256_and_si256(_mm256_cmpgt_epi32(y, _mm256_set1_epi32(0xFF)),
+			      _mm256_set1_epi32(8));
+	y = _mm256_srlv_epi32(y, b8);
+	b4 = _mm256_and_si256(_mm256_cmpgt_epi32(y, _mm256_set1_epi32(0xF)),
+			      _mm256_set1_epi32(4));
+	y = _mm256_srlv_epi32(y, b4);
+	b2 = _mm256_and_si256(_mm256_cmpgt_epi32(y, _mm256_set1_epi32(0x3)),
+			      _mm256_set1_epi32(2));
+	y = _mm256_srlv_epi32(y, b2);
+	b1 = _mm256_and_si256(_mm256_cmpgt_epi32(y, _mm256_set1_epi32(0x1)),
+			      _mm256_set1_epi32(1));
+	y = _mm256_srlv_epi32(y, b1);
+	sum = _mm256_add_epi32(_mm256_add_epi32(b16, b8),
+			       _mm256_add_epi32(b4, b2));
+	sum = _mm256_add_epi32(sum, _mm256_add_epi32(b1, y));
+	sum = _mm256_add_epi32(sum, _mm256_set1_epi32(1));
+	_mm256_storeu_si256((__m256i *) (out + i), sum);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int isLessOrEqual_avx2(const int *x, const int *y, int *out, int n)
+{
+    __m256i a, b;
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+	a = _mm256_loadu_si256((const __m256i *) (x + i));
+	b = _mm256_loadu_si256((const __m256i *) (y + i));
+	_mm256_storeu_si256((__m256i *) (out + i),
+			    _mm256_andnot_si256(_mm256_cmpgt_epi32(a, b),
+						_mm256_set1_epi32(1)));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int logicalNeg_avx2(const int *x, int *out, int n)
+{
+    __m256i v;
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+	v = _mm256_loadu_si256((const __m256i *) (x + i));
+	_mm256_storeu_si256((__m256i *) (out + i),
+			    _mm256_and_si256(_mm256_cmpeq_epi32(v, _mm256_setzero_si256()),
+					     _mm256_set1_epi32(1)));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int floatScale2_avx2(const unsigned *uf, unsigned *out, int n)
+{
+    const __m256i exp_mask = _mm256_set1_epi32(0x7F800000);
+    __m256i v, exp, denorm, norm, inf, r;
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+	v = _mm256_loadu_si256((const __m256i *) (uf + i));
+	exp = _mm256_and_si256(v, exp_mask);
+	denorm = _mm256_or_si256(_mm256_and_si256(v, _mm256_set1_epi32(0x80000000)),
+				 _mm256_slli_epi32(v, 1));
+	norm = _mm256_add_epi32(v, _mm256_set1_epi32(0x00800000));
+	inf = _mm256_cmpeq_epi32(_mm256_and_si256(norm, exp_mask), exp_mask);
+	norm = _mm256_andnot_si256(_mm256_and_si256(inf, _mm256_set1_epi32(0x007FFFFF)),
+				   norm);
+	r = _mm256_blendv_epi8(norm, denorm,
+			       _mm256_cmpeq_epi32(exp, _mm256_setzero_si256()));
+	r = _mm256_blendv_epi8(r, v, _mm256_cmpeq_epi32(exp, exp_mask));
+	_mm256_storeu_si256((__m256i *) (out + i), r);
+    }
+    return i;
+}
+
+/* Variable shifts by 32 or more give 0, so both shifts can be or'ed
+   together without clamping their counts */
+__attribute__((target("avx2")))
+static int floatFloat2Int_avx2(const unsigned *uf, int *out, int n)
+{
+    __m256i v, exp, frac, val, sign;
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+	v = _mm256_loadu_si256((const __m256i *) (uf + i));
+	exp = _mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(v, 23),
+						_mm256_set1_epi32(0xFF)),
+			       _mm256_set1_epi32(127));
+	frac = _mm256_or_si256(_mm256_and_si256(v, _mm256_set1_epi32(0x7FFFFF)),
+			       _mm256_set1_epi32(0x800000));
+	val = _mm256_or_si256(
+	    _mm256_sllv_epi32(frac, _mm256_sub_epi32(exp, _mm256_set1_epi32(23))),
+	    _mm256_srlv_epi32(frac, _mm256_sub_epi32(_mm256_set1_epi32(23), exp)));
+	sign = _mm256_srai_epi32(v, 31);
+	val = _mm256_sub_epi32(_mm256_xor_si256(val, sign), sign);
+	val = _mm256_blendv_epi8(val, _mm256_set1_epi32(0x80000000),
+				 _mm256_cmpgt_epi32(exp, _mm256_set1_epi32(30)));
+	_mm256_storeu_si256((__m256i *) (out + i), val);
+    }
+    return i;
+}
+#endif
+
+/*
+ * simd - Whether to use the AVX2 versions
+ */
+static int simd(void)
+{
+    if (use_simd < 0)
+	use_simd = batch_has_simd();
+    return use_simd;
+}
+
+int batch_has_simd(void)
+{
+#ifdef BATCH_AVX2
+    return __builtin_cpu_supports("avx2");
+#else
+    return 0;
+#endif
+}
+
+void batch_use_simd(int enable)
+{
+    use_simd = enable && batch_has_simd();
+}
+
+/**********************
+ * The batch functions
+ **********************/
+
+void howManyBits_batch(const int *x, int *out, int n)
+{
+    int i = 0;
+
+#ifdef BATCH_AVX2
+    if (simd())
+	i = howManyBits_avx2(x, out, n);
+#endif
+    for (; i < n; i++)
+	out[i] = howManyBits_one(x[i]);
+}
+
+void isLessOrEqual_batch(const int *x, const int *y, int *out, int n)
+{
+    int i = 0;
+
+#ifdef BATCH_AVX2
+    if (simd())
+	i = isLessOrEqual_avx2(x, y, out, n);
+#endif
+    for (; i < n; i++)
+	out[i] = x[i] <= y[i];
+}
+
+void logicalNeg_batch(const int *x, int *out, int n)
+{
+    int i = 0;
+
+#ifdef BATCH_AVX2
+    if (simd())
+	i = logicalNeg_avx2(x, out, n);
+#endif
+    for (; i < n; i++)
+	out[i] = x[i] == 0;
+}
+
+void floatScale2_batch(const unsigned *uf, unsigned *out, int n)
+{
+    int i = 0;
+
+#ifdef BATCH_AVX2
+    if (simd())
+	i = floatScale2_avx2(uf, out, n);
+#endif
+    for (; i < n; i++)
+	out[i] = floatScale2_one(uf[i]);
+}
+
+void floatFloat2Int_batch(const unsigned *uf, int *out, int n)
+{
+    int i = 0;
+
+#ifdef BATCH_AVX2
+    if (simd())
+	i = floatFloat2Int_avx2(uf, out, n);
+#endif
+    for (; i < n; i++)
+	out[i] = floatFloat2Int_one(uf[i]);
+}
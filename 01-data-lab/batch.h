@@ -0,0 +1,16 @@
+/*
+ * CS:APP Data Lab
+ *
+ * batch.h - Array forms of some of the puzzles in bits.c. Each one sets
+ *           out[i] to the puzzle's result on the i-th argument(s).
+ */
+void howManyBits_batch(const int *x, int *out, int n);
+void isLessOrEqual_batch(const int *x, const int *y, int *out, int n);
+void logicalNeg_batch(const int *x, int *out, int n);
+void floatScale2_batch(const unsigned *uf, unsigned *out, int n);
+void floatFloat2Int_batch(const unsigned *uf, int *out, int n);
+
+/* Explicit AVX2 versions are used when the CPU has AVX2, unless turned
+   off with batch_use_simd(0), which leaves the generic loops */
+int batch_has_simd(void);
+void batch_use_simd(int enable);
@@ -0,0 +1,435 @@
+/*
+ * CS:APP Data Lab
+ *
+ * bbench.c - Times the functions in bits.c, the reference functions in
+ *            tests.c, and builtin versions where the compiler has one,
+ *            over arrays of random arguments.
+ *
+ * Op counts are only a proxy for speed: the reference functions may
+ * loop, and the solutions may branch. All three are called through
+ * function pointers, so each time includes the same call overhead.
+ *
+ * With -B, the array forms in batch.c are checked against the bits.c
+ * functions instead, and timed per value against a loop calling them.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "btest.h"
+#include "batch.h"
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define UNIT "cycles"
+#else
+#define UNIT "ns"
+#endif
+
+/* Default number of random arguments per function, and of timed passes
+   over them, of which the fastest is kept */
+#define INPUTS (1 << 20)
+#define REPEATS 5
+
+/* Defined in decl.c */
+extern test_rec test_set[];
+
+/* Defined in tests.c */
+unsigned f2u(float f);
+
+/* Arguments that the random ones rarely hit, tried first by -B: zero,
+   the ends of the int range, and the float boundaries */
+static unsigned special_args[] = {
+    0, 1, 0xFFFFFFFF, 0x80000000, 0x7FFFFFFF,
+    0x00000001, 0x007FFFFF, 0x00800000, 0x3F800000, 0x4EFFFFFF,
+    0x4F000000, 0x7F7FFFFF, 0x7F800000, 0x7FC00000, 0x80000001,
+    0x807FFFFF, 0x80800000, 0xBF800000, 0xCF000000, 0xCF000001,
+    0xFF7FFFFF, 0xFF800000, 0xFFC00000
+};
+#define SPECIAL_ARGS (int) (sizeof(special_args) / sizeof(special_args[0]))
+
+/* Array forms of the puzzles, from batch.c. The unsigned ones are
+   called as if they took ints. */
+typedef void (*batch1_t)(const int *, int *, int);
+typedef void (*batch2_t)(const int *, const int *, int *, int);
+static struct {
+    char *name;
+    void (*batch)();
+} batches[] = {
+    {"isLessOrEqual", (void (*)()) isLessOrEqual_batch},
+    {"logicalNeg", (void (*)()) logicalNeg_batch},
+    {"howManyBits", (void (*)()) howManyBits_batch},
+    {"floatScale2", (void (*)()) floatScale2_batch},
+    {"floatFloat2Int", (void (*)()) floatFloat2Int_batch},
+    {NULL, NULL}
+};
+
+/* Write-once globals defined by command line args */
+static int bench_batches = 0;   /* -B */
+static char *test_fname = NULL; /* -f */
+static int inputs = INPUTS;     /* -n */
+static int repeats = REPEATS;   /* -r */
+
+/* Results are summed into here, so that no call can be optimized away */
+volatile int sink;
+
+/*******************************************
+ * Builtin versions of some of the puzzles
+ *******************************************/
+
+static int builtin_allOddBits(int x)
+{
+    return (x & 0xAAAAAAAA) == 0xAAAAAAAA;
+}
+
+static int builtin_isAsciiDigit(int x)
+{
+    return (unsigned) x - 0x30 <= 9;
+}
+
+static int builtin_howManyBits(int x)
+{
+    unsigned y = x ^ (x >> 31);
+    return y ? 33 - __builtin_clz(y) : 1;
+}
+
+/* Out of range exponents are clamped to ones that still round to 0 or
+   overflow to +inf */
+static unsigned builtin_floatPower2(int x)
+{
+    if (x < -150)
+	x = -150;
+    if (x > 128)
+	x = 128;
+    return f2u(__builtin_ldexpf(1.0f, x));
+}
+
+static struct {
+    char *name;
+    funct_t funct;
+} builtins[] = {
+    {"allOddBits", (funct_t) builtin_allOddBits},
+    {"isAsciiDigit", (funct_t) builtin_isAsciiDigit},
+    {"howManyBits", (funct_t) builtin_howManyBits},
+    {"floatPower2", (funct_t) builtin_floatPower2},
+    {NULL, NULL}
+};
+
+/******************
+ * Helper functions
+ ******************/
+
+/*
+ * now - Read the time stamp counter, or the monotonic clock in ns where
+ *     there is none
+ */
+static unsigned long long now()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/*
+ * random_arg - Return a random argument between min and max. Floating
+ *     point puzzles, with a range of {1,1}, take any bit pattern.
+ */
+static int random_arg(int min, int max)
+{
+    unsigned bits = ((unsigned) rand() << 16) ^ (unsigned) rand();
+
+    if (min == 1 && max == 1)
+	return bits;
+    if ((unsigned) max - (unsigned) min == 0xFFFFFFFF)
+	return bits;
+    return min + bits % ((unsigned) max - (unsigned) min + 1);
+}
+
+/*
+ * call_all - Call f once for every set of arguments. Return the sum of
+ *     the results.
+ */
+static int call_all(funct_t f, int args, int *vals[3])
+{
+    int i, sum = 0;
+
+    switch (args) {
+    case 0:
+	for (i = 0; i < inputs; i++)
+	    sum += f();
+	break;
+    case 1:
+	for (i = 0; i < inputs; i++)
+	    sum += ((funct1_t) f)(vals[0][i]);
+	break;
+    case 2:
+	for (i = 0; i < inputs; i++)
+	    sum += ((funct2_t) f)(vals[0][i], vals[1][i]);
+	break;
+    default:
+	for (i = 0; i < inputs; i++)
+	    sum += ((funct3_t) f)(vals[0][i], vals[1][i], vals[2][i]);
+    }
+    return sum;
+}
+
+/*
+ * time_calls - Return the time per call of f, in the fastest of the
+ *     passes over the arguments
+ */
+static double __attribute__((noinline))
+time_calls(funct_t f, int args, int *vals[3])
+{
+    unsigned long long begin, elapsed, best = ~0ULL;
+    int r;
+
+    for (r = 0; r < repeats; r++) {
+	begin = now();
+	sink = call_all(f, args, vals);
+	elapsed = now() - begin;
+	if (elapsed < best)
+	    best = elapsed;
+    }
+    return (double) best / inputs;
+}
+
+/*
+ * agrees - Check that a builtin version gives the results of the
+ *     reference function on every argument
+ */
+static int agrees(funct_t f, funct_t ft, int args, int *vals[3])
+{
+    int i;
+
+    for (i = 0; i < inputs; i++) {
+	if (args == 1 && ((funct1_t) f)(vals[0][i]) !=
+	    ((funct1_t) ft)(vals[0][i]))
+	    return 0;
+	if (args == 2 && ((funct2_t) f)(vals[0][i], vals[1][i]) !=
+	    ((funct2_t) ft)(vals[0][i], vals[1][i]))
+	    return 0;
+    }
+    return 1;
+}
+
+/*
+ * bench_function - Time one puzzle, its reference function, and its
+ *     builtin version if it has one
+ */
+static void bench_function(test_ptr t, int *vals[3])
+{
+    funct_t builtin = NULL;
+    int i, a;
+
+    for (a = 0; a < t->args; a++)
+	for (i = 0; i < inputs; i++)
+	    vals[a][i] = random_arg(t->arg_ranges[a][0], t->arg_ranges[a][1]);
+    for (i = 0; builtins[i].name; i++)
+	if (strcmp(builtins[i].name, t->name) == 0)
+	    builtin = builtins[i].funct;
+
+    printf("%-16s %9.2f %9.2f", t->name,
+	   time_calls(t->solution_funct, t->args, vals),
+	   time_calls(t->test_funct, t->args, vals));
+    if (!builtin)
+	printf(" %9s\n", "-");
+    else if (!agrees(builtin, t->test_funct, t->args, vals))
+	printf(" %9s\n", "wrong");
+    else
+	printf(" %9.2f\n", time_calls(builtin, t->args, vals));
+}
+
+/*
+ * run_batch - Apply an array form to the first n sets of arguments
+ */
+static void run_batch(void (*batch)(), int args, int *vals[3], int *out,
+		      int n)
+{
+    if (args == 1)
+	((batch1_t) batch)(vals[0], out, n);
+    else
+	((batch2_t) batch)(vals[0], vals[1], out, n);
+}
+
+/*
+ * check_batch - Check an array form against the bits.c function, on all
+ *     of the arguments, and on an odd number of them so that the end is
+ *     not a whole vector
+ */
+static int check_batch(void (*batch)(), test_ptr t, int *vals[3], int *out)
+{
+    int i, n, r = 0;
+
+    for (n = inputs; n > 0; n = n > 13 ? 13 : 0) {
+	memset(out, 0, n * sizeof(int));
+	run_batch(batch, t->args, vals, out, n);
+	for (i = 0; i < n; i++) {
+	    if (t->args == 1)
+		r = ((funct1_t) t->solution_funct)(vals[0][i]);
+	    else
+		r = ((funct2_t) t->solution_funct)(vals[0][i], vals[1][i]);
+	    if (out[i] != r) {
+		printf("ERROR: %s_batch gives %d[0x%x] at argument %d "
+		       "(first %d[0x%x]). Should be %d[0x%x]\n",
+		       t->name, out[i], out[i], i, vals[0][i], vals[0][i],
+		       r, r);
+		return 0;
+	    }
+	}
+    }
+    return 1;
+}
+
+/*
+ * time_batch - Return the time per value of an array form, in the
+ *     fastest of the passes over the arguments
+ */
+static double time_batch(void (*batch)(), int args, int *vals[3], int *out)
+{
+    unsigned long long begin, elapsed, best = ~0ULL;
+    int r;
+
+    for (r = 0; r < repeats; r++) {
+	begin = now();
+	run_batch(batch, args, vals, out, inputs);
+	elapsed = now() - begin;
+	if (elapsed < best)
+	    best = elapsed;
+    }
+    sink = out[inputs - 1];
+    return (double) best / inputs;
+}
+
+/*
+ * bench_batch - Check and time the generic and AVX2 array forms of one
+ *     puzzle against a loop calling the bits.c function
+ */
+static void bench_batch(void (*batch)(), test_ptr t, int *vals[3], int *out)
+{
+    double scalar, generic, simd = 0;
+    int i, a;
+
+    for (a = 0; a < t->args; a++) {
+	for (i = 0; i < inputs; i++)
+	    vals[a][i] = random_arg(t->arg_ranges[a][0], t->arg_ranges[a][1]);
+	/* The special arguments go first, each against all of them */
+	for (i = 0; i < SPECIAL_ARGS * SPECIAL_ARGS && i < inputs; i++)
+	    vals[a][i] = special_args[a ? i / SPECIAL_ARGS : i % SPECIAL_ARGS];
+    }
+
+    batch_use_simd(0);
+    if (!check_batch(batch, t, vals, out))
+	return;
+    scalar = time_calls(t->solution_funct, t->args, vals);
+    generic = time_batch(batch, t->args, vals, out);
+    if (batch_has_simd()) {
+	batch_use_simd(1);
+	if (!check_batch(batch, t, vals, out))
+	    return;
+	simd = time_batch(batch, t->args, vals, out);
+    }
+
+    printf("%-16s %9.2f %9.2f", t->name, scalar, generic);
+    if (simd)
+	printf(" %9.2f %8.1fx\n", simd, scalar / simd);
+    else
+	printf(" %9s %8.1fx\n", "-", scalar / generic);
+}
+
+/*
+ * usage - Display usage info
+ */
+static void usage(char *cmd) {
+    printf("Usage: %s [-hB] [-f <name>] [-n <num>] [-r <num>]\n", cmd);
+    printf("  -B        Check and time the array forms in batch.c instead\n");
+    printf("  -f <name> Time only the named function\n");
+    printf("  -h        Print this message\n");
+    printf("  -n <num>  Call each function on num random arguments (default %d)\n", INPUTS);
+    printf("  -r <num>  Keep the fastest of num passes (default %d)\n", REPEATS);
+    exit(1);
+}
+
+/**************
+ * Main routine
+ **************/
+
+int main(int argc, char *argv[])
+{
+    int *vals[3], *out;
+    int i, j, found = 0;
+    char c;
+
+    while ((c = getopt(argc, argv, "hBf:n:r:")) != -1)
+	switch (c) {
+	case 'B': /* array forms instead */
+	    bench_batches = 1;
+	    break;
+	case 'f': /* time only one function */
+	    test_fname = optarg;
+	    break;
+	case 'n': /* number of random arguments */
+	    inputs = atoi(optarg);
+	    if (inputs <= 0)
+		usage(argv[0]);
+	    break;
+	case 'r': /* number of passes */
+	    repeats = atoi(optarg);
+	    if (repeats <= 0)
+		usage(argv[0]);
+	    break;
+	default:
+	    usage(argv[0]);
+	}
+
+    for (i = 0; i < 3; i++) {
+	vals[i] = malloc(inputs * sizeof(int));
+	if (!vals[i]) {
+	    printf("Unable to allocate %d arguments\n", inputs);
+	    exit(1);
+	}
+    }
+
+    if (bench_batches) {
+	out = malloc(inputs * sizeof(int));
+	if (!out) {
+	    printf("Unable to allocate %d results\n", inputs);
+	    exit(1);
+	}
+	printf("%s per value over %d random arguments, fastest of %d passes\n",
+	       UNIT, inputs, repeats);
+	printf("%-16s %9s %9s %9s %9s\n", "Function", "bits.c", "generic",
+	       "AVX2", "speedup");
+	for (i = 0; batches[i].name; i++) {
+	    if (test_fname && strcmp(batches[i].name, test_fname) != 0)
+		continue;
+	    for (j = 0; strcmp(test_set[j].name, batches[i].name) != 0; j++)
+		;
+	    bench_batch(batches[i].batch, &test_set[j], vals, out);
+	    found = 1;
+	}
+	if (!found) {
+	    printf("No array form of %s\n", test_fname);
+	    exit(1);
+	}
+	return 0;
+    }
+
+    printf("%s per call over %d random arguments, fastest of %d passes\n",
+	   UNIT, inputs, repeats);
+    printf("%-16s %9s %9s %9s\n", "Function", "bits.c", "tests.c", "builtin");
+    for (i = 0; test_set[i].solution_funct; i++) {
+	if (!test_fname || strcmp(test_set[i].name, test_fname) == 0) {
+	    bench_function(&test_set[i], vals);
+	    found = 1;
+	}
+    }
+    if (!found) {
+	printf("No function named %s\n", test_fname);
+	exit(1);
+    }
+    return 0;
+}
@@ -339,10 +339,11 @@ int floatFloat2Int(unsigned uf) {
  *   Rating: 4
  */
 unsigned floatPower2(int x) {
-    x += 127;
-    if (x <= 0)
+    if (x < -149)
         return 0;
-    if (x >= 255)
+    if (x < -126)
+        return 1 << (x + 149);
+    if (x > 127)
         return 0x7F800000;
-    return x << 23;
+    return (x + 127) << 23;
 }
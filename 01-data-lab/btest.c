@@ -21,6 +21,10 @@
 #include <signal.h>
 #include <setjmp.h>
 #include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/wait.h>
 #include "btest.h"
 
 /* Not declared in some stdlib.h files, so define here */
@@ -46,6 +50,17 @@ float strtof(const char *nptr, char **endptr);
    TEST_RANGE, thus MAX_TEST_VALS must be at least k*TEST_RANGE */
 #define MAX_TEST_VALS 13*TEST_RANGE
 
+/* The exhaustive test (-x) hands inputs to its threads EXHAUSTIVE_CHUNK
+   at a time, and compares results EXHAUSTIVE_BLOCK at a time */
+#define EXHAUSTIVE_INPUTS (1ULL << 32)
+#define EXHAUSTIVE_CHUNK (1 << 20)
+#define EXHAUSTIVE_BLOCK 4096
+
+/* With more than one thread (-j), each function's tests are cut into
+   about this many shards per thread, along the values of its first
+   argument */
+#define SHARDS_PER_THREAD 8
+
 /**********************************
  * Globals defined in other modules 
  **********************************/
@@ -74,6 +89,22 @@ static unsigned argval[3] = {0,0,0};
 /* Use fixed weight for rating, and if so, what should it  be? (-r) */
 static int global_rating = 0;
 
+/* Test one-argument puzzles on every 32-bit input (-x) */
+static int exhaustive = 0;
+
+/* Threads that run the tests (-j) */
+static int threads = 0;
+
+/* The state shared by the threads of an exhaustive test */
+typedef struct {
+    funct1_t f;                  /* solution */
+    funct1_t ft;                 /* reference */
+    unsigned long long next;     /* first input of the next chunk */
+    unsigned long long mismatch; /* lowest mismatching input found */
+    unsigned long long tested;   /* inputs tested so far */
+    pthread_mutex_t lock;
+} sweep_t;
+
 /******************
  * Helper functions
  ******************/
@@ -96,6 +127,28 @@ handler_t *Signal(int signum, handler_t *handler)
     return (old_action.sa_handler);
 }
 
+/* The tests of one function, as shards for the thread pool */
+typedef struct {
+    test_ptr t;
+    int counts[3];        /* number of test values for each arg */
+    int *vals[3];         /* test values for each arg */
+    int shards;           /* shards, by ranges of first arg values */
+    int next;             /* next shard to hand out */
+    int done;             /* shards finished or skipped */
+    long long first_error; /* lowest failing test in serial order, or -1 */
+} job_t;
+
+/* The thread pool. It is started afresh in a child process for each
+   function, so that a function that times out can be killed along with
+   all of its threads. */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;     /* a job has been posted */
+    pthread_cond_t finished; /* the last shard of the job is done */
+    job_t *job;
+} pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+	  PTHREAD_COND_INITIALIZER, NULL};
+
 /* 
  * timeout_handler - SIGALARM hander 
  */
@@ -104,6 +157,8 @@ void timeout_handler(int sig) {
     siglongjmp(envbuf, 1);
 }
 
+static int test_sharded(test_ptr t, int test_counts[], int arg_test_vals[][MAX_TEST_VALS]);
+
 /* 
  * random_val - Return random integer value between min and max 
  */
@@ -344,6 +399,10 @@ static int test_function(test_ptr t) {
 
     }
 
+    /* Shard the tests across the thread pool */
+    if (threads > 1 && args > 0)
+	return test_sharded(t, test_counts, arg_test_vals);
+
     /* Handle timeouts in the test code */
     if (timeout_limit > 0) {
 	int rc;
@@ -418,6 +477,280 @@ static int test_function(test_ptr t) {
     return errors;
 }
 
+/*
+ * sweep_thread - Test chunks of inputs until they run out, or until the
+ *     rest lie above a known mismatch. Chunks are handed out in order,
+ *     so the lowest mismatching input is always found.
+ */
+static void *sweep_thread(void *arg)
+{
+    sweep_t *sweep = arg;
+    int r[EXHAUSTIVE_BLOCK], rt[EXHAUSTIVE_BLOCK];
+    unsigned long long chunk, block, tested, mismatch;
+    int k, diff;
+
+    for (;;) {
+	pthread_mutex_lock(&sweep->lock);
+	chunk = sweep->next;
+	sweep->next += EXHAUSTIVE_CHUNK;
+	mismatch = sweep->mismatch;
+	pthread_mutex_unlock(&sweep->lock);
+	if (chunk >= EXHAUSTIVE_INPUTS || chunk > mismatch)
+	    return NULL;
+
+	for (block = chunk, tested = 0; block < chunk + EXHAUSTIVE_CHUNK;
+	     block += EXHAUSTIVE_BLOCK, tested += EXHAUSTIVE_BLOCK) {
+	    /* Results are compared a block at a time, in a loop the
+	       compiler can vectorize */
+	    for (k = 0; k < EXHAUSTIVE_BLOCK; k++)
+		r[k] = sweep->f((int) (unsigned) (block + k));
+	    for (k = 0; k < EXHAUSTIVE_BLOCK; k++)
+		rt[k] = sweep->ft((int) (unsigned) (block + k));
+	    diff = 0;
+	    for (k = 0; k < EXHAUSTIVE_BLOCK; k++)
+		diff |= r[k] ^ rt[k];
+	    if (diff) {
+		for (k = 0; r[k] == rt[k]; k++)
+		    ;
+		pthread_mutex_lock(&sweep->lock);
+		if (block + k < sweep->mismatch)
+		    sweep->mismatch = block + k;
+		pthread_mutex_unlock(&sweep->lock);
+		tested += k + 1;
+		break;
+	    }
+	}
+	pthread_mutex_lock(&sweep->lock);
+	sweep->tested += tested;
+	pthread_mutex_unlock(&sweep->lock);
+    }
+}
+
+/*
+ * test_exhaustive - Test a one-argument function on all 2^32 inputs,
+ *     split across threads. Return number of errors, which is at most
+ *     one: the lowest mismatching input is reported.
+ */
+static int test_exhaustive(test_ptr t)
+{
+    sweep_t sweep;
+    pthread_t tids[threads];
+    struct timespec begin, end;
+    double seconds;
+    int i;
+
+    sweep.f = (funct1_t) t->solution_funct;
+    sweep.ft = (funct1_t) t->test_funct;
+    sweep.next = sweep.tested = 0;
+    sweep.mismatch = EXHAUSTIVE_INPUTS;
+    pthread_mutex_init(&sweep.lock, NULL);
+
+    /* The time limit of the sampled test does not apply to this one */
+    alarm(0);
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (i = 0; i < threads; i++) {
+	if (pthread_create(&tids[i], NULL, sweep_thread, &sweep)) {
+	    printf("Unable to create a thread for %s\n", t->name);
+	    exit(1);
+	}
+    }
+    for (i = 0; i < threads; i++)
+	pthread_join(tids[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pthread_mutex_destroy(&sweep.lock);
+
+    seconds = end.tv_sec - begin.tv_sec + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    if (!grade)
+	printf("Exhaustive %s: %llu inputs in %.2f secs (%.1f M/sec, %d threads)\n",
+	       t->name, sweep.tested, seconds, sweep.tested / seconds / 1e6,
+	       threads);
+
+    /* Rerun the mismatch to report it like any other failed test */
+    if (sweep.mismatch < EXHAUSTIVE_INPUTS)
+	return test_1_arg(t->solution_funct, t->test_funct,
+			  (int) (unsigned) sweep.mismatch, t->name);
+    return 0;
+}
+
+/*
+ * run_shard - Run the tests of a range of first argument values, in the
+ *     serial order. Return the index of the first failing test in that
+ *     order, or -1.
+ */
+static long long run_shard(job_t *job, int a1_begin, int a1_end)
+{
+    funct_t f = job->t->solution_funct, ft = job->t->test_funct;
+    int *v1 = job->vals[0], *v2 = job->vals[1], *v3 = job->vals[2];
+    int c2 = job->counts[1], c3 = job->counts[2];
+    int a1, a2, a3;
+
+    for (a1 = a1_begin; a1 < a1_end; a1++) {
+	if (job->t->args == 1) {
+	    if (((funct1_t) f)(v1[a1]) != ((funct1_t) ft)(v1[a1]))
+		return a1;
+	    continue;
+	}
+	for (a2 = 0; a2 < c2; a2++) {
+	    if (job->t->args == 2) {
+		if (((funct2_t) f)(v1[a1], v2[a2]) !=
+		    ((funct2_t) ft)(v1[a1], v2[a2]))
+		    return (long long) a1 * c2 + a2;
+		continue;
+	    }
+	    for (a3 = 0; a3 < c3; a3++) {
+		if (((funct3_t) f)(v1[a1], v2[a2], v3[a3]) !=
+		    ((funct3_t) ft)(v1[a1], v2[a2], v3[a3]))
+		    return ((long long) a1 * c2 + a2) * c3 + a3;
+	    }
+	}
+    }
+    return -1;
+}
+
+/*
+ * pool_thread - Run shards of the posted job. A shard that starts past
+ *     a known error is skipped, as the serial tests would have stopped
+ *     before it.
+ */
+static void *pool_thread(void *arg)
+{
+    job_t *job;
+    long long first, error;
+    int shard, a1_begin, a1_end;
+
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+	while (!pool.job || pool.job->next == pool.job->shards)
+	    pthread_cond_wait(&pool.work, &pool.lock);
+	job = pool.job;
+	shard = job->next++;
+	a1_begin = (long long) job->counts[0] * shard / job->shards;
+	a1_end = (long long) job->counts[0] * (shard + 1) / job->shards;
+	first = (long long) a1_begin * (job->counts[1] ? job->counts[1] : 1) *
+	    (job->counts[2] ? job->counts[2] : 1);
+	if (job->first_error < 0 || first < job->first_error) {
+	    pthread_mutex_unlock(&pool.lock);
+	    error = run_shard(job, a1_begin, a1_end);
+	    pthread_mutex_lock(&pool.lock);
+	    if (error >= 0 &&
+		(job->first_error < 0 || error < job->first_error))
+		job->first_error = error;
+	}
+	if (++job->done == job->shards)
+	    pthread_cond_signal(&pool.finished);
+    }
+    return NULL;
+}
+
+/*
+ * run_pool - Run the shards of a job on a new pool of threads, in the
+ *     child process of test_sharded, and send back its first error
+ */
+static void run_pool(job_t *job, int fd)
+{
+    pthread_t tid;
+    int i;
+
+    for (i = 0; i < threads; i++) {
+	if (pthread_create(&tid, NULL, pool_thread, NULL)) {
+	    printf("Unable to create a test thread\n");
+	    exit(1);
+	}
+	pthread_detach(tid);
+    }
+    pthread_mutex_lock(&pool.lock);
+    pool.job = job;
+    pthread_cond_broadcast(&pool.work);
+    while (job->done < job->shards)
+	pthread_cond_wait(&pool.finished, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+    if (write(fd, &job->first_error, sizeof(job->first_error)) < 0)
+	exit(1);
+    _exit(0);
+}
+
+/*
+ * test_sharded - Run the tests of a function on the thread pool. Return
+ *     number of errors, reporting the same first error as the serial
+ *     tests would.
+ */
+static int test_sharded(test_ptr t, int test_counts[], int arg_test_vals[][MAX_TEST_VALS])
+{
+    job_t job;
+    struct pollfd pfd;
+    long long error;
+    int i, rc, status, fd[2], vals[3];
+    pid_t pid;
+
+    job.t = t;
+    for (i = 0; i < 3; i++) {
+	job.counts[i] = i < t->args ? test_counts[i] : 0;
+	job.vals[i] = arg_test_vals[i];
+    }
+    job.shards = threads * SHARDS_PER_THREAD;
+    if (job.shards > job.counts[0])
+	job.shards = job.counts[0];
+    job.next = job.done = 0;
+    job.first_error = -1;
+
+    /* The shards are run by a child, which is killed if it takes too
+       long. The timeout is kept by polling for its result, so any alarm
+       left by a serial test must not go off. */
+    alarm(0);
+    fflush(stdout);
+    if (pipe(fd) < 0 || (pid = fork()) < 0) {
+	perror("Unable to start the tests");
+	exit(1);
+    }
+    if (pid == 0) {
+	close(fd[0]);
+	run_pool(&job, fd[1]);
+    }
+    close(fd[1]);
+
+    pfd.fd = fd[0];
+    pfd.events = POLLIN;
+    rc = poll(&pfd, 1, timeout_limit > 0 ? timeout_limit * 1000 : -1);
+    if (rc > 0)
+	rc = read(fd[0], &job.first_error, sizeof(job.first_error)) ==
+	    sizeof(job.first_error) ? 1 : -1;
+    close(fd[0]);
+    if (rc == 0)
+	kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+
+    if (rc == 0) {
+	printf("ERROR: Test %s failed.\n  Timed out after %d secs (probably infinite loop)\n", t->name, timeout_limit);
+	return 1;
+    }
+    if (rc < 0) {
+	printf("ERROR: Test %s failed.\n  Crashed (%s)\n", t->name,
+	       WIFSIGNALED(status) ? strsignal(WTERMSIG(status)) : "no result");
+	return 1;
+    }
+    if (job.first_error < 0)
+	return 0;
+
+    /* Rerun the first error to report it as the serial tests do */
+    error = job.first_error;
+    for (i = t->args - 1; i > 0; i--) {
+	vals[i] = job.vals[i][error % job.counts[i]];
+	error /= job.counts[i];
+    }
+    vals[0] = job.vals[0][error];
+    switch (t->args) {
+    case 1:
+	return test_1_arg(t->solution_funct, t->test_funct, vals[0], t->name);
+    case 2:
+	return test_2_arg(t->solution_funct, t->test_funct, vals[0], vals[1],
+			  t->name);
+    default:
+	return test_3_arg(t->solution_funct, t->test_funct, vals[0], vals[1],
+			  vals[2], t->name);
+    }
+}
+
 /* 
  * run_tests - Run series of tests.  Return number of errors 
  */ 
@@ -437,6 +770,10 @@ static int run_tests()
 	if (!test_fname || strcmp(test_set[i].name,test_fname) == 0) {
 	    int rating = global_rating ? global_rating : test_set[i].rating;
 	    terrors = test_function(&test_set[i]);
+	    /* The sampled test runs first, under the time limit, so that
+	       the exhaustive test is unlikely to hit an infinite loop */
+	    if (exhaustive && !terrors && test_set[i].args == 1 && !has_arg[0])
+		terrors = test_exhaustive(&test_set[i]);
 	    errors += terrors;
 	    tscore = terrors == 0 ? 1.0 : 0.0;
 	    tpoints = rating * tscore;
@@ -506,15 +843,17 @@ static int get_num_val(char *sval, unsigned *valp) {
  * usage - Display usage info
  */
 static void usage(char *cmd) {
-    printf("Usage: %s [-hg] [-r <n>] [-f <name> [-1|-2|-3 <val>]*] [-T <time limit>]\n", cmd);
+    printf("Usage: %s [-hgx] [-j <n>] [-r <n>] [-f <name> [-1|-2|-3 <val>]*] [-T <time limit>]\n", cmd);
     printf("  -1 <val>  Specify first function argument\n");
     printf("  -2 <val>  Specify second function argument\n");
     printf("  -3 <val>  Specify third function argument\n");
     printf("  -f <name> Test only the named function\n");
     printf("  -g        Compact output for grading (with no error msgs)\n");
     printf("  -h        Print this message\n");
+    printf("  -j <n>    Run the tests on n threads (default: one per CPU)\n");
     printf("  -r <n>    Give uniform weight of n for all problems\n");
     printf("  -T <lim>  Set timeout limit to lim\n");
+    printf("  -x        Also test one-argument functions on all 2^32 inputs\n");
     exit(1);
 }
 
@@ -528,7 +867,7 @@ int main(int argc, char *argv[])
     char c;
 
     /* parse command line args */
-    while ((c = getopt(argc, argv, "hgf:r:T:1:2:3:")) != -1)
+    while ((c = getopt(argc, argv, "hgxf:j:r:T:1:2:3:")) != -1)
         switch (c) {
         case 'h': /* help */
 	    usage(argv[0]);
@@ -536,6 +875,14 @@ int main(int argc, char *argv[])
 	case 'g': /* grading option for autograder */
 	    grade = 1;
 	    break;
+	case 'x': /* test one-argument functions exhaustively */
+	    exhaustive = 1;
+	    break;
+	case 'j': /* threads that run the tests */
+	    threads = atoi(optarg);
+	    if (threads <= 0)
+		usage(argv[0]);
+	    break;
 	case 'f': /* test only one function */
 	    test_fname = strdup(optarg);
 	    break;
@@ -576,6 +923,12 @@ int main(int argc, char *argv[])
 	Signal(SIGALRM, timeout_handler);
     }
 
+    if (!threads) {
+	threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0)
+	    threads = 1;
+    }
+
     /* test each function */
     run_tests();
 
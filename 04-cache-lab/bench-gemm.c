@@ -0,0 +1,224 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <err.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cachelab.h"
+#include "utils.h"
+
+/* Timed batches per function; the fastest one is kept */
+#define BATCHES 5
+#define MIN_BATCH_SECONDS 0.01
+
+/* Square sizes of the default sweep, from L1-resident to L3-resident */
+static const int sweep_sizes[] = {32, 64, 128, 256, 512};
+#define SWEEP_SIZES (int)(sizeof(sweep_sizes) / sizeof(sweep_sizes[0]))
+
+typedef struct s_option {
+    int M, N, K;
+    int F;
+    const char *o;
+} t_option;
+
+typedef struct s_result {
+    double ns_per_fma;
+    double gflops;
+} t_result;
+
+static const char *usage_format =
+    "Usage: %s [-h] [-M <rows> -N <cols> -K <depth>] [-F <num>] "
+    "[-o <file>]\n"
+    "Options:\n"
+    "  -h          Print this help message.\n"
+    "  -M <rows>   Rows of A and C; without -M, -N and -K, square sizes\n"
+    "              from 32 to 512 are swept.\n"
+    "  -N <cols>   Columns of B and C.\n"
+    "  -K <depth>  Columns of A and rows of B.\n"
+    "  -F <num>    Only benchmark this registered function.\n"
+    "  -o <file>   Also write \"func ns/fma GFLOP/s\" lines to a file.\n"
+    "\n"
+    "Examples:\n"
+    "  linux>  %s\n"
+    "  linux>  %s -M 1024 -N 1024 -K 256 -F 3\n";
+
+/* External function defined in gemm.c */
+extern void registerGemmFunctions();
+
+/* External variables defined in cachelab.c */
+extern gemm_func_t gemm_func_list[MAX_TRANS_FUNCS];
+extern int gemm_func_counter;
+
+static void benchmark_size(const t_option *option, int M, int N, int K,
+                           FILE *results_file);
+static bool check_function(int i, int M, int N, int K, double *A, double *B,
+                           double *C);
+static void parse_arguments(int argc, char *const argv[], t_option *option);
+static void print_usage_and_exit(const char *program_name, int exit_code);
+static void run_function(int i, int M, int N, int K, double *A, double *B,
+                         double *C, long runs);
+static double seconds_since(const struct timespec *begin);
+static t_result time_function(int i, int M, int N, int K, double *A,
+                              double *B, double *C);
+
+int main(int argc, char *argv[]) {
+    t_option option = {0};
+    FILE *results_file = NULL;
+    int i;
+
+    parse_arguments(argc, argv, &option);
+    registerGemmFunctions();
+    if (option.F >= gemm_func_counter) {
+        fprintf(stderr, "%s: No function %d\n", argv[0], option.F);
+        print_usage_and_exit(argv[0], EXIT_FAILURE);
+    }
+    if (option.o)
+        results_file = safe_fopen(option.o, "w");
+    if (option.M) {
+        benchmark_size(&option, option.M, option.N, option.K, results_file);
+    } else {
+        for (i = 0; i < SWEEP_SIZES; i++)
+            benchmark_size(&option, sweep_sizes[i], sweep_sizes[i],
+                           sweep_sizes[i], results_file);
+    }
+    if (results_file && fclose(results_file))
+        err(EXIT_FAILURE, "%s", option.o);
+    return EXIT_SUCCESS;
+}
+
+static void benchmark_size(const t_option *option, int M, int N, int K,
+                           FILE *results_file) {
+    double *A = safe_calloc((size_t)M * K, sizeof(double));
+    double *B = safe_calloc((size_t)K * N, sizeof(double));
+    double *C = safe_calloc((size_t)M * N, sizeof(double));
+    t_result result;
+    int i;
+
+    printf("%dx%dx%d\n", M, N, K);
+    for (i = 0; i < gemm_func_counter; i++) {
+        if (option->F >= 0 && i != option->F)
+            continue;
+        if (!check_function(i, M, N, K, A, B, C)) {
+            printf("func %d (%s): wrong product\n", i,
+                   gemm_func_list[i].description);
+            continue;
+        }
+        result = time_function(i, M, N, K, A, B, C);
+        printf("func %d (%s): ns/fma:%.3f GFLOP/s:%.2f\n", i,
+               gemm_func_list[i].description, result.ns_per_fma,
+               result.gflops);
+        if (results_file)
+            fprintf(results_file, "%d %.3f %.2f\n", i, result.ns_per_fma,
+                    result.gflops);
+    }
+    safe_free((void **)&A);
+    safe_free((void **)&B);
+    safe_free((void **)&C);
+}
+
+static bool check_function(int i, int M, int N, int K, double *A, double *B,
+                           double *C) {
+    double *R = safe_calloc((size_t)M * N, sizeof(double));
+    bool correct;
+
+    initGemm(M, N, K, (void *)A, (void *)B, (void *)C);
+    correctGemm(M, N, K, (void *)A, (void *)B, (void *)R);
+    run_function(i, M, N, K, A, B, C, 1);
+    correct = !memcmp(C, R, (size_t)M * N * sizeof(double));
+    safe_free((void **)&R);
+    return correct;
+}
+
+static void parse_arguments(int argc, char *const argv[], t_option *option) {
+    const char *program_name = argv[0];
+    int opt;
+
+    option->F = -1;
+    while ((opt = getopt(argc, argv, "hM:N:K:F:o:")) != -1) {
+        switch (opt) {
+        case 'h':
+            print_usage_and_exit(program_name, EXIT_SUCCESS);
+        case 'M':
+            option->M = atoi(optarg);
+            break;
+        case 'N':
+            option->N = atoi(optarg);
+            break;
+        case 'K':
+            option->K = atoi(optarg);
+            break;
+        case 'F':
+            option->F = atoi(optarg);
+            break;
+        case 'o':
+            option->o = optarg;
+            break;
+        default:
+            print_usage_and_exit(program_name, EXIT_FAILURE);
+        }
+    }
+    if (option->M < 0 || option->N < 0 || option->K < 0 ||
+        !option->M != !option->N || !option->M != !option->K) {
+        fprintf(stderr, "%s: Invalid matrix size\n", program_name);
+        print_usage_and_exit(program_name, EXIT_FAILURE);
+    }
+}
+
+static void print_usage_and_exit(const char *program_name, int exit_code) {
+    FILE *stream = exit_code == EXIT_SUCCESS ? stdout : stderr;
+
+    fprintf(stream, usage_format, program_name, program_name, program_name);
+    exit(exit_code);
+}
+
+static void run_function(int i, int M, int N, int K, double *A, double *B,
+                         double *C, long runs) {
+    long run;
+
+    for (run = 0; run < runs; run++)
+        gemm_func_list[i].func_ptr(M, N, K, (void *)A, (void *)B, (void *)C);
+}
+
+static double seconds_since(const struct timespec *begin) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return end.tv_sec - begin->tv_sec + (end.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+/*
+ * Batched as in bench-trans: the number of runs per batch doubles until a
+ * batch takes long enough for the clock, and the fastest batch is kept.
+ */
+static t_result time_function(int i, int M, int N, int K, double *A,
+                              double *B, double *C) {
+    double fmas = (double)M * N * K;
+    double seconds, best;
+    struct timespec begin;
+    t_result result;
+    long runs = 1;
+    int batch;
+
+    for (;;) {
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        run_function(i, M, N, K, A, B, C, runs);
+        if ((seconds = seconds_since(&begin)) >= MIN_BATCH_SECONDS)
+            break;
+        runs *= 2;
+    }
+    best = seconds;
+    for (batch = 1; batch < BATCHES; batch++) {
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        run_function(i, M, N, K, A, B, C, runs);
+        if ((seconds = seconds_since(&begin)) < best)
+            best = seconds;
+    }
+    result.ns_per_fma = best / runs / fmas * 1e9;
+    /* Every multiply-add is two floating-point operations. */
+    result.gflops = 2 * fmas * runs / best / 1e9;
+    return result;
+}
@@ -0,0 +1,457 @@
+#define _GNU_SOURCE
+
+#include <err.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "cachelab.h"
+#include "utils.h"
+
+#define HUGE_PAGE_SIZE (2 << 20)
+
+/* Timed batches per function; the fastest one is kept */
+#define BATCHES 5
+#define MIN_BATCH_SECONDS 0.01
+
+/* Square sizes of the default sweep, from L1-resident to DRAM-resident */
+static const int sweep_sizes[] = {32, 64, 128, 256, 512, 1024, 2048, 4096,
+                                  8192};
+#define SWEEP_SIZES (int)(sizeof(sweep_sizes) / sizeof(sweep_sizes[0]))
+
+/* Shapes of the default batch sweep, as M x N */
+static const int batch_shapes[][2] = {{8, 8}, {16, 16}, {32, 32}, {64, 64},
+                                      {61, 67}};
+#define BATCH_SHAPES (int)(sizeof(batch_shapes) / sizeof(batch_shapes[0]))
+
+/* The ways of transposing a batch that -b compares */
+enum { BATCH_LOOP, BATCH_CALL, BATCH_INTERLEAVED, BATCH_MODES };
+static const char *batch_descriptions[BATCH_MODES] = {
+    "transpose_submit per matrix", "transpose_batch",
+    "transpose_batch_interleaved"};
+
+typedef struct s_option {
+    int M, N;
+    int F;
+    int b;
+    bool H;
+    const char *o;
+} t_option;
+
+typedef struct s_buffer {
+    int *data;
+    size_t length;
+    bool mapped;
+} t_buffer;
+
+typedef struct s_result {
+    double ns_per_element;
+    double gb_per_second;
+} t_result;
+
+/* One registered function on one pair of matrices */
+typedef struct s_call {
+    int i;
+    int M, N;
+    int *A, *B;
+} t_call;
+
+/*
+ * count matrices of one shape, both as separate matrices, which lie back
+ * to back in a and b, and interleaved, in ia and ib.
+ */
+typedef struct s_batch {
+    int mode;
+    int M, N;
+    int count;
+    int *a, *b;
+    int **A, **B;
+    int *ia, *ib;
+} t_batch;
+
+static const char *usage_format =
+    "Usage: %s [-hH] [-M <cols> -N <rows>] [-F <num> | -b <count>] "
+    "[-o <file>]\n"
+    "Options:\n"
+    "  -h         Print this help message.\n"
+    "  -H         Back the matrices with huge pages.\n"
+    "  -b <count> Time the batched entry points against a loop of\n"
+    "             transpose_submit, on batches of count matrices; without\n"
+    "             -M and -N, shapes from 8x8 to 61x67 are swept.\n"
+    "  -M <cols>  Number of matrix columns; without -M and -N, square sizes\n"
+    "             from 32 to 8192 are swept.\n"
+    "  -N <rows>  Number of matrix rows.\n"
+    "  -F <num>   Only benchmark this registered function.\n"
+    "  -o <file>  Also write \"func ns/elem GB/s\" lines to a file.\n"
+    "\n"
+    "Examples:\n"
+    "  linux>  %s\n"
+    "  linux>  %s -H -M 4096 -N 4096 -F 0\n"
+    "  linux>  %s -b 1000\n";
+
+/* External function defined in trans.c */
+extern void registerFunctions();
+
+/* Defined in trans.c */
+void transpose_submit(int M, int N, int A[N][M], int B[M][N]);
+void transpose_batch(int M, int N, int count, int *const A[],
+                     int *const B[]);
+void transpose_batch_interleaved(int M, int N, int count, const int *A,
+                                 int *B);
+
+/* External variables defined in cachelab.c */
+extern trans_func_t func_list[MAX_TRANS_FUNCS];
+extern int func_counter;
+
+static void alloc_buffer(t_buffer *buffer, size_t length, bool huge);
+static void benchmark_batch(const t_option *option, int M, int N,
+                            FILE *results_file);
+static void benchmark_size(const t_option *option, int M, int N,
+                           FILE *results_file);
+static bool check_batch(t_batch *batch);
+static bool check_function(int i, int M, int N, int *A, int *B);
+static void free_buffer(t_buffer *buffer);
+static void parse_arguments(int argc, char *const argv[], t_option *option);
+static void print_usage_and_exit(const char *program_name, int exit_code);
+static void run_batch(void *context, long runs);
+static void run_call(void *context, long runs);
+static void run_function(int i, int M, int N, int *A, int *B, long runs);
+static double seconds_since(const struct timespec *begin);
+static t_result time_runs(void (*run)(void *context, long runs),
+                          void *context, double elements);
+
+int main(int argc, char *argv[]) {
+    t_option option = {0};
+    FILE *results_file = NULL;
+    int i;
+
+    parse_arguments(argc, argv, &option);
+    registerFunctions();
+    if (option.F >= func_counter) {
+        fprintf(stderr, "%s: No function %d\n", argv[0], option.F);
+        print_usage_and_exit(argv[0], EXIT_FAILURE);
+    }
+    if (option.o)
+        results_file = safe_fopen(option.o, "w");
+    if (option.b && option.M) {
+        benchmark_batch(&option, option.M, option.N, results_file);
+    } else if (option.b) {
+        for (i = 0; i < BATCH_SHAPES; i++)
+            benchmark_batch(&option, batch_shapes[i][0], batch_shapes[i][1],
+                            results_file);
+    } else if (option.M) {
+        benchmark_size(&option, option.M, option.N, results_file);
+    } else {
+        for (i = 0; i < SWEEP_SIZES; i++)
+            benchmark_size(&option, sweep_sizes[i], sweep_sizes[i],
+                           results_file);
+    }
+    if (results_file && fclose(results_file))
+        err(EXIT_FAILURE, "%s", option.o);
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Explicit huge pages come from the reserved pool; when it is empty, the
+ * buffer is mapped normally and transparent huge pages are asked for.
+ */
+static void alloc_buffer(t_buffer *buffer, size_t length, bool huge) {
+    size_t size = length * sizeof(int);
+
+    buffer->length = length;
+    buffer->mapped = huge;
+    if (!huge) {
+        buffer->data = safe_calloc(length, sizeof(int));
+        return;
+    }
+    size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    buffer->data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (buffer->data != MAP_FAILED)
+        return;
+    buffer->data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer->data == MAP_FAILED)
+        err(EXIT_FAILURE, "mmap");
+    if (madvise(buffer->data, size, MADV_HUGEPAGE))
+        warn("madvise");
+}
+
+/*
+ * The matrices of a batch come from one allocation each, one after the
+ * other, as a caller holding many small matrices would likely keep them.
+ */
+static void benchmark_batch(const t_option *option, int M, int N,
+                            FILE *results_file) {
+    size_t elements = (size_t)M * N * option->b;
+    t_batch batch = {0, M, N, option->b};
+    t_result result;
+    size_t k;
+
+    batch.a = safe_calloc(elements, sizeof(int));
+    batch.b = safe_calloc(elements, sizeof(int));
+    batch.ia = safe_calloc(elements, sizeof(int));
+    batch.ib = safe_calloc(elements, sizeof(int));
+    batch.A = safe_calloc(batch.count, sizeof(int *));
+    batch.B = safe_calloc(batch.count, sizeof(int *));
+    for (k = 0; k < (size_t)batch.count; k++) {
+        batch.A[k] = batch.a + k * M * N;
+        batch.B[k] = batch.b + k * M * N;
+    }
+    for (k = 0; k < elements; k++)
+        batch.a[k] = (int)k;
+    printf("%d x %dx%d (%zu KB per batch)\n", batch.count, M, N,
+           elements * sizeof(int) / 1024);
+    for (batch.mode = 0; batch.mode < BATCH_MODES; batch.mode++) {
+        if (!check_batch(&batch)) {
+            printf("%s: wrong transpose\n", batch_descriptions[batch.mode]);
+            continue;
+        }
+        result = time_runs(run_batch, &batch, elements);
+        printf("%s: ns/elem:%.3f GB/s:%.2f\n", batch_descriptions[batch.mode],
+               result.ns_per_element, result.gb_per_second);
+        if (results_file)
+            fprintf(results_file, "%d %.3f %.2f\n", batch.mode,
+                    result.ns_per_element, result.gb_per_second);
+    }
+    safe_free((void **)&batch.a);
+    safe_free((void **)&batch.b);
+    safe_free((void **)&batch.ia);
+    safe_free((void **)&batch.ib);
+    safe_free((void **)&batch.A);
+    safe_free((void **)&batch.B);
+}
+
+static void benchmark_size(const t_option *option, int M, int N,
+                           FILE *results_file) {
+    t_buffer A, B;
+    t_call call;
+    t_result result;
+    size_t k;
+    int i;
+
+    alloc_buffer(&A, (size_t)M * N, option->H);
+    alloc_buffer(&B, (size_t)M * N, option->H);
+    call = (t_call){0, M, N, A.data, B.data};
+    for (k = 0; k < A.length; k++)
+        A.data[k] = (int)k;
+    /* Fault every page in before anything is timed. */
+    memset(B.data, 0, B.length * sizeof(int));
+    printf("%dx%d (%zu KB per matrix)\n", M, N, A.length * sizeof(int) / 1024);
+    for (i = 0; i < func_counter; i++) {
+        /* Typed functions need buffers of their own element size. */
+        if ((option->F >= 0 && i != option->F) || func_list[i].typed_ptr)
+            continue;
+        if (!check_function(i, M, N, A.data, B.data)) {
+            printf("func %d (%s): wrong transpose\n", i,
+                   func_list[i].description);
+            continue;
+        }
+        call.i = i;
+        result = time_runs(run_call, &call, (double)M * N);
+        printf("func %d (%s): ns/elem:%.3f GB/s:%.2f\n", i,
+               func_list[i].description, result.ns_per_element,
+               result.gb_per_second);
+        if (results_file)
+            fprintf(results_file, "%d %.3f %.2f\n", i, result.ns_per_element,
+                    result.gb_per_second);
+    }
+    free_buffer(&A);
+    free_buffer(&B);
+}
+
+/*
+ * The interleaved layout is filled from the separate matrices, and
+ * checked against them, outside of the timed runs.
+ */
+static bool check_batch(t_batch *batch) {
+    size_t size = (size_t)batch->M * batch->N;
+    size_t k, e;
+    int r, c;
+
+    for (k = 0; k < (size_t)batch->count; k++)
+        for (e = 0; e < size; e++)
+            batch->ia[e * batch->count + k] = batch->A[k][e];
+    memset(batch->b, 0, size * batch->count * sizeof(int));
+    memset(batch->ib, 0, size * batch->count * sizeof(int));
+    run_batch(batch, 1);
+    for (k = 0; k < (size_t)batch->count; k++) {
+        for (r = 0; r < batch->N; r++) {
+            for (c = 0; c < batch->M; c++) {
+                e = (size_t)c * batch->N + r;
+                if (batch->mode == BATCH_INTERLEAVED
+                        ? batch->ib[e * batch->count + k] !=
+                              batch->A[k][(size_t)r * batch->M + c]
+                        : batch->B[k][e] !=
+                              batch->A[k][(size_t)r * batch->M + c])
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool check_function(int i, int M, int N, int *A, int *B) {
+    int r, c;
+
+    prepareTransFunction(i, M, N, (void *)A, (void *)B);
+    run_function(i, M, N, A, B, 1);
+    for (r = 0; r < N; r++)
+        for (c = 0; c < M; c++)
+            if (A[(size_t)r * M + c] != B[(size_t)c * N + r])
+                return false;
+    return true;
+}
+
+static void free_buffer(t_buffer *buffer) {
+    size_t size = buffer->length * sizeof(int);
+
+    if (!buffer->mapped) {
+        safe_free((void **)&buffer->data);
+        return;
+    }
+    size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    munmap(buffer->data, size);
+}
+
+static void parse_arguments(int argc, char *const argv[], t_option *option) {
+    const char *program_name = argv[0];
+    int opt;
+
+    option->F = -1;
+    while ((opt = getopt(argc, argv, "hHM:N:F:b:o:")) != -1) {
+        switch (opt) {
+        case 'h':
+            print_usage_and_exit(program_name, EXIT_SUCCESS);
+        case 'H':
+            option->H = true;
+            break;
+        case 'M':
+            option->M = atoi(optarg);
+            break;
+        case 'N':
+            option->N = atoi(optarg);
+            break;
+        case 'F':
+            option->F = atoi(optarg);
+            break;
+        case 'b':
+            option->b = atoi(optarg);
+            if (option->b <= 0) {
+                fprintf(stderr, "%s: Invalid batch size\n", program_name);
+                print_usage_and_exit(program_name, EXIT_FAILURE);
+            }
+            break;
+        case 'o':
+            option->o = optarg;
+            break;
+        default:
+            print_usage_and_exit(program_name, EXIT_FAILURE);
+        }
+    }
+    if (option->M < 0 || option->N < 0 || !option->M != !option->N) {
+        fprintf(stderr, "%s: Invalid matrix size\n", program_name);
+        print_usage_and_exit(program_name, EXIT_FAILURE);
+    }
+    if (option->b && option->F >= 0) {
+        fprintf(stderr, "%s: -b and -F are exclusive\n", program_name);
+        print_usage_and_exit(program_name, EXIT_FAILURE);
+    }
+}
+
+static void print_usage_and_exit(const char *program_name, int exit_code) {
+    FILE *stream = exit_code == EXIT_SUCCESS ? stdout : stderr;
+
+    fprintf(stream, usage_format, program_name, program_name, program_name,
+            program_name);
+    exit(exit_code);
+}
+
+static void run_batch(void *context, long runs) {
+    t_batch *batch = context;
+    long run;
+    int k;
+
+    for (run = 0; run < runs; run++) {
+        switch (batch->mode) {
+        case BATCH_LOOP:
+            for (k = 0; k < batch->count; k++)
+                transpose_submit(batch->M, batch->N, (void *)batch->A[k],
+                                 (void *)batch->B[k]);
+            break;
+        case BATCH_CALL:
+            transpose_batch(batch->M, batch->N, batch->count, batch->A,
+                            batch->B);
+            break;
+        default:
+            transpose_batch_interleaved(batch->M, batch->N, batch->count,
+                                        batch->ia, batch->ib);
+        }
+    }
+}
+
+static void run_call(void *context, long runs) {
+    t_call *call = context;
+
+    run_function(call->i, call->M, call->N, call->A, call->B, runs);
+}
+
+/*
+ * An in-place function keeps working on B, whose shape flips with every
+ * run; timing it from a fresh copy each time would time the copy too.
+ */
+static void run_function(int i, int M, int N, int *A, int *B, long runs) {
+    long run;
+
+    for (run = 0; run < runs; run++) {
+        if (!func_list[i].inplace_ptr)
+            func_list[i].func_ptr(M, N, (void *)A, (void *)B);
+        else if (run % 2 == 0)
+            func_list[i].inplace_ptr(M, N, B);
+        else
+            func_list[i].inplace_ptr(N, M, B);
+    }
+}
+
+static double seconds_since(const struct timespec *begin) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return end.tv_sec - begin->tv_sec + (end.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+/*
+ * The number of runs per batch doubles until a batch takes long enough
+ * for the clock, then the fastest of BATCHES batches is reported.
+ */
+static t_result time_runs(void (*run)(void *context, long runs),
+                          void *context, double elements) {
+    double seconds, best = 0;
+    struct timespec begin;
+    t_result result;
+    long runs = 1;
+    int batch;
+
+    for (;;) {
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        run(context, runs);
+        if ((seconds = seconds_since(&begin)) >= MIN_BATCH_SECONDS)
+            break;
+        runs *= 2;
+    }
+    best = seconds;
+    for (batch = 1; batch < BATCHES; batch++) {
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        run(context, runs);
+        if ((seconds = seconds_since(&begin)) < best)
+            best = seconds;
+    }
+    result.ns_per_element = best / runs / elements * 1e9;
+    /* Every element is read once and written once. */
+    result.gb_per_second = 2 * elements * sizeof(int) * runs / best / 1e9;
+    return result;
+}
@@ -0,0 +1,119 @@
+#include "cache.h"
+
+#include <string.h>
+
+#include "utils.h"
+
+/*
+ * User-space addresses on x86-64 fit in 48 bits, which usually leaves room
+ * for 32-bit tags. A wider address widens the tags on the fly.
+ */
+#define ADDRESS_BITS 48
+
+static size_t find_tag(const t_cache *cache, const void *tags, size_t fill,
+                       uint64_t tag);
+
+const char *access_memory(uint64_t address, t_cache *cache, t_count *count) {
+    const char *result = "hit";
+    size_t E = cache->E;
+    uint64_t tag = address >> (cache->s + cache->b);
+    uint64_t set_index = (address >> cache->b) & (cache->S - 1);
+    uint32_t *fill = &cache->fills[set_index];
+    size_t tag_size, line;
+    char *tags;
+
+    if (cache->tag_size < sizeof(uint64_t) && tag > UINT32_MAX)
+        widen_tags(cache);
+    tag_size = cache->tag_size;
+    tags = (char *)cache->tags + set_index * E * tag_size;
+    line = find_tag(cache, tags, *fill, tag);
+    if (line < *fill) {
+        count->hit += 1;
+    } else if (*fill < E) {
+        line = (*fill)++;
+        count->miss += 1;
+        result = "miss";
+    } else {
+        line = E - 1;
+        count->miss += 1;
+        count->eviction += 1;
+        result = "miss eviction";
+    }
+    memmove(tags + tag_size, tags, line * tag_size);
+    set_tag(cache, set_index * E, tag);
+    return result;
+}
+
+/*
+ * The address of the line an access to `address` would evict, or
+ * UINT64_MAX when the access would hit or fill a free line.
+ */
+uint64_t find_victim(const t_cache *cache, uint64_t address) {
+    size_t E = cache->E;
+    uint64_t tag = address >> (cache->s + cache->b);
+    uint64_t set_index = (address >> cache->b) & (cache->S - 1);
+    uint32_t fill = cache->fills[set_index];
+    const char *tags =
+        (const char *)cache->tags + set_index * E * cache->tag_size;
+
+    if (fill < E || find_tag(cache, tags, fill, tag) < fill)
+        return UINT64_MAX;
+    return get_tag(cache, set_index * E + E - 1) << (cache->s + cache->b) |
+           set_index << cache->b;
+}
+
+void free_cache(t_cache *cache) {
+    safe_free((void **)&cache->fills);
+    safe_free(&cache->tags);
+}
+
+uint64_t get_tag(const t_cache *cache, size_t line) {
+    if (cache->tag_size == sizeof(uint32_t))
+        return ((const uint32_t *)cache->tags)[line];
+    return ((const uint64_t *)cache->tags)[line];
+}
+
+void init_cache(t_cache *cache, size_t s, size_t E, size_t b) {
+    cache->E = E;
+    cache->b = b;
+    cache->s = s;
+    cache->S = (size_t)1 << s;
+    cache->tag_size = s + b + 32 >= ADDRESS_BITS ? sizeof(uint32_t)
+                                                 : sizeof(uint64_t);
+    cache->fills = (uint32_t *)safe_calloc(cache->S, sizeof(uint32_t));
+    cache->tags = safe_calloc(cache->S * E, cache->tag_size);
+}
+
+void set_tag(t_cache *cache, size_t line, uint64_t tag) {
+    if (cache->tag_size == sizeof(uint32_t))
+        ((uint32_t *)cache->tags)[line] = tag;
+    else
+        ((uint64_t *)cache->tags)[line] = tag;
+}
+
+void widen_tags(t_cache *cache) {
+    size_t lines = cache->S * cache->E;
+    uint64_t *tags = (uint64_t *)safe_calloc(lines, sizeof(uint64_t));
+    size_t i;
+
+    for (i = 0; i < lines; ++i)
+        tags[i] = get_tag(cache, i);
+    safe_free(&cache->tags);
+    cache->tags = tags;
+    cache->tag_size = sizeof(uint64_t);
+}
+
+static size_t find_tag(const t_cache *cache, const void *tags, size_t fill,
+                       uint64_t tag) {
+    const uint32_t *tags32 = tags;
+    const uint64_t *tags64 = tags;
+    size_t i = 0;
+
+    if (cache->tag_size == sizeof(uint32_t))
+        while (i < fill && tags32[i] != tag)
+            ++i;
+    else
+        while (i < fill && tags64[i] != tag)
+            ++i;
+    return i;
+}
@@ -0,0 +1,35 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct s_count {
+    size_t eviction;
+    size_t hit;
+    size_t miss;
+} t_count;
+
+/*
+ * The tags of a set are kept in `tags[set * E ...]` ordered from the most to
+ * the least recently used, so a line's LRU rank is its position and needs no
+ * storage. Lines are never invalidated, so the valid lines of a set are
+ * always the first `fills[set]` ones.
+ */
+typedef struct s_cache {
+    size_t E, S;
+    size_t b, s;
+    size_t tag_size;
+    uint32_t *fills;
+    void *tags;
+} t_cache;
+
+const char *access_memory(uint64_t address, t_cache *cache, t_count *count);
+uint64_t find_victim(const t_cache *cache, uint64_t address);
+void free_cache(t_cache *cache);
+uint64_t get_tag(const t_cache *cache, size_t line);
+void init_cache(t_cache *cache, size_t s, size_t E, size_t b);
+void set_tag(t_cache *cache, size_t line, uint64_t tag);
+void widen_tags(t_cache *cache);
+
+#endif
@@ -3,6 +3,7 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "cachelab.h"
 #include <time.h>
@@ -10,6 +11,12 @@
 trans_func_t func_list[MAX_TRANS_FUNCS];
 int func_counter = 0; 
 
+par_trans_func_t par_func_list[MAX_TRANS_FUNCS];
+int par_func_counter = 0;
+
+gemm_func_t gemm_func_list[MAX_TRANS_FUNCS];
+int gemm_func_counter = 0;
+
 /* 
  * printSummary - Summarize the cache simulation statistics. Student cache simulators
  *                must call this function in order to be properly autograded. 
@@ -74,6 +81,9 @@ void registerTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]),
                            char* desc)
 {
     func_list[func_counter].func_ptr = trans;
+    func_list[func_counter].inplace_ptr = NULL;
+    func_list[func_counter].typed_ptr = NULL;
+    func_list[func_counter].size = 0;
     func_list[func_counter].description = desc;
     func_list[func_counter].correct = 0;
     func_list[func_counter].num_hits = 0;
@@ -81,3 +91,108 @@ void registerTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]),
     func_list[func_counter].num_evictions =0;
     func_counter++;
 }
+
+/*
+ * registerInPlaceTransFunction - Add the given in-place trans function
+ *     into your list of functions to be tested
+ */
+void registerInPlaceTransFunction(void (*trans)(int M, int N, int*),
+                                  char* desc)
+{
+    registerTransFunction(NULL, desc);
+    func_list[func_counter - 1].inplace_ptr = trans;
+}
+
+/*
+ * registerTypedTransFunction - Add the given trans function on elements
+ *     of `size` bytes into your list of functions to be tested with -T
+ */
+void registerTypedTransFunction(void (*trans)(int M, int N, void*, void*),
+                                int size, char* desc)
+{
+    registerTransFunction(NULL, desc);
+    func_list[func_counter - 1].typed_ptr = trans;
+    func_list[func_counter - 1].size = size;
+}
+
+/*
+ * prepareTransFunction - An in-place function is run on B, so that A is
+ *     kept for validation: give B the contents of A, row for row, before
+ *     the function is traced
+ */
+void prepareTransFunction(int i, int M, int N, int A[N][M], int B[M][N])
+{
+    if (func_list[i].inplace_ptr)
+        memcpy(&B[0][0], &A[0][0], (size_t)M * N * sizeof(int));
+}
+
+/*
+ * registerParTransFunction - Add the given parallel trans function into
+ *     the list of functions run by par-trans
+ */
+void registerParTransFunction(
+    void (*trans)(int M, int N, int[N][M], int[M][N], int thread, int threads),
+    char* desc)
+{
+    par_func_list[par_func_counter].func_ptr = trans;
+    par_func_list[par_func_counter].description = desc;
+    par_func_counter++;
+}
+
+/*
+ * initGemm - Fill A and B with small integers and C with garbage, so
+ *     that a multiply that does not overwrite all of C is caught
+ */
+void initGemm(int M, int N, int K, double A[M][K], double B[K][N],
+              double C[M][N])
+{
+    int i, j;
+
+    srand(time(NULL));
+    for (i = 0; i < M; i++)
+        for (j = 0; j < K; j++)
+            A[i][j] = rand() % 16 - 8;
+    for (i = 0; i < K; i++)
+        for (j = 0; j < N; j++)
+            B[i][j] = rand() % 16 - 8;
+    for (i = 0; i < M; i++)
+        for (j = 0; j < N; j++)
+            C[i][j] = rand();
+}
+
+/*
+ * correctGemm - The baseline multiply
+ */
+void correctGemm(int M, int N, int K, double A[M][K], double B[K][N],
+                 double C[M][N])
+{
+    int i, j, k;
+    double sum;
+
+    for (i = 0; i < M; i++) {
+        for (j = 0; j < N; j++) {
+            sum = 0;
+            for (k = 0; k < K; k++)
+                sum += A[i][k] * B[k][j];
+            C[i][j] = sum;
+        }
+    }
+}
+
+/*
+ * registerGemmFunction - Add the given multiply into the list of
+ *     functions run by test-gemm and bench-gemm
+ */
+void registerGemmFunction(
+    void (*gemm)(int M, int N, int K, double[M][K], double[K][N],
+                 double[M][N]),
+    char* desc)
+{
+    gemm_func_list[gemm_func_counter].func_ptr = gemm;
+    gemm_func_list[gemm_func_counter].description = desc;
+    gemm_func_list[gemm_func_counter].correct = 0;
+    gemm_func_list[gemm_func_counter].num_hits = 0;
+    gemm_func_list[gemm_func_counter].num_misses = 0;
+    gemm_func_list[gemm_func_counter].num_evictions = 0;
+    gemm_func_counter++;
+}
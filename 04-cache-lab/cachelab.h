@@ -7,8 +7,14 @@
 
 #define MAX_TRANS_FUNCS 100
 
+/* Largest element of a typed trans function, in bytes */
+#define MAX_ELEMENT_SIZE 16
+
 typedef struct trans_func{
   void (*func_ptr)(int M,int N,int[N][M],int[M][N]);
+  void (*inplace_ptr)(int M,int N,int*); /* set instead of func_ptr */
+  void (*typed_ptr)(int M,int N,void*,void*); /* or instead of both */
+  int size; /* bytes per element of typed_ptr, 0 for int functions */
   char* description;
   char correct;
   unsigned int num_hits;
@@ -16,6 +22,40 @@ typedef struct trans_func{
   unsigned int num_evictions;
 } trans_func_t;
 
+/* A transpose run by every thread of a pool, each doing its own share */
+typedef struct par_trans_func{
+  void (*func_ptr)(int M,int N,int[N][M],int[M][N],int thread,int threads);
+  char* description;
+} par_trans_func_t;
+
+/* A matrix multiply C = A x B of an M x K matrix A by a K x N matrix B,
+   which overwrites C */
+typedef struct gemm_func{
+  void (*func_ptr)(int M,int N,int K,double[M][K],double[K][N],double[M][N]);
+  char* description;
+  char correct;
+  unsigned int num_hits;
+  unsigned int num_misses;
+  unsigned int num_evictions;
+} gemm_func_t;
+
+/* Loop orders of a tuned blocking, see trans_tuning_t */
+#define TUNE_BLOCKS_BY_COLUMN 1 /* visit blocks column by column */
+#define TUNE_INNER_BY_COLUMN 2  /* walk each block column by column */
+
+/* A blocking for an M x N transpose, as chosen by tune-trans */
+typedef struct trans_tuning{
+  int M;
+  int N;
+  int rows;     /* block height, in rows of A */
+  int cols;     /* block width, in columns of A */
+  int order;    /* TUNE_* flags */
+  int diagonal; /* write each diagonal element after the rest of its row */
+} trans_tuning_t;
+
+/* Room in the table of trans-tune.h, counting the entry that ends it */
+#define MAX_TRANS_TUNINGS 16
+
 /* 
  * printSummary - This function provides a standard way for your cache
  * simulator * to display its final hit and miss statistics
@@ -34,4 +74,35 @@ void correctTrans(int M, int N, int A[N][M], int B[M][N]);
 void registerTransFunction(
     void (*trans)(int M,int N,int[N][M],int[M][N]), char* desc);
 
+/* Add the given in-place function, which turns an N x M matrix into
+   its M x N transpose within the same buffer */
+void registerInPlaceTransFunction(void (*trans)(int M,int N,int*), char* desc);
+
+/* Add the given function on elements of `size` bytes, which takes A and
+   B as N x M and M x N arrays of that element type */
+void registerTypedTransFunction(void (*trans)(int M,int N,void*,void*),
+                                int size, char* desc);
+
+/* Copy A into B if function i works in place, as it then runs on B */
+void prepareTransFunction(int i, int M, int N, int A[N][M], int B[M][N]);
+
+/* Add the given parallel function to the parallel function list */
+void registerParTransFunction(
+    void (*trans)(int M,int N,int[N][M],int[M][N],int thread,int threads),
+    char* desc);
+
+/* Fill the factors of a multiply with small integers, whose products
+   and sums doubles hold exactly, and C with garbage */
+void initGemm(int M, int N, int K, double A[M][K], double B[K][N],
+              double C[M][N]);
+
+/* The baseline multiply that produces correct results. */
+void correctGemm(int M, int N, int K, double A[M][K], double B[K][N],
+                 double C[M][N]);
+
+/* Add the given multiply to the multiply function list */
+void registerGemmFunction(
+    void (*gemm)(int M,int N,int K,double[M][K],double[K][N],double[M][N]),
+    char* desc);
+
 #endif /* CACHELAB_TOOLS_H */
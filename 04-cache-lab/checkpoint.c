@@ -0,0 +1,135 @@
+#include "checkpoint.h"
+
+#include <err.h>
+#include <string.h>
+
+#include "utils.h"
+
+/*
+ * A checkpoint is a header of 64-bit words, the fill count of every set, and
+ * then the valid tags of every set in the cache's own tag width.
+ */
+static const char magic[8] = "CSIMCKP2";
+
+enum e_header {
+    H_S,
+    H_E,
+    H_B,
+    H_TAG_SIZE,
+    H_HIT,
+    H_MISS,
+    H_EVICTION,
+    H_OFFSET,
+    H_LENGTH
+};
+
+static void read_tags(FILE *file, const char *pathname, t_cache *cache,
+                      size_t tag_size);
+static void read_words(FILE *file, const char *pathname, uint64_t *words,
+                       size_t n);
+static void write_words(FILE *file, const char *pathname,
+                        const uint64_t *words, size_t n);
+
+void load_checkpoint(const char *pathname, t_cache *cache, t_count *count,
+                     long *offset) {
+    FILE *file = safe_fopen(pathname, "rb");
+    char buffer[sizeof(magic)];
+    uint64_t header[H_LENGTH];
+
+    if (fread(buffer, sizeof(buffer), 1, file) != 1 ||
+        memcmp(buffer, magic, sizeof(magic)))
+        errx(EXIT_FAILURE, "%s: Not a csim checkpoint", pathname);
+    read_words(file, pathname, header, H_LENGTH);
+    if (header[H_S] != cache->s || header[H_E] != cache->E ||
+        header[H_B] != cache->b)
+        errx(EXIT_FAILURE, "%s: Saved with -s %lu -E %lu -b %lu", pathname,
+             header[H_S], header[H_E], header[H_B]);
+    count->hit = header[H_HIT];
+    count->miss = header[H_MISS];
+    count->eviction = header[H_EVICTION];
+    *offset = header[H_OFFSET];
+    if (fread(cache->fills, sizeof(uint32_t), cache->S, file) != cache->S)
+        errx(EXIT_FAILURE, "%s: Truncated checkpoint", pathname);
+    read_tags(file, pathname, cache, header[H_TAG_SIZE]);
+    fclose(file);
+}
+
+/*
+ * The checkpoint is written next to its final name and renamed over it, so
+ * a crash while saving leaves the previous checkpoint intact.
+ */
+void save_checkpoint(const char *pathname, const t_cache *cache,
+                     const t_count *count, long offset) {
+    char *temp_pathname = safe_calloc(strlen(pathname) + 5, 1);
+    size_t tag_size = cache->tag_size;
+    uint64_t header[H_LENGTH];
+    FILE *file;
+    size_t i;
+
+    sprintf(temp_pathname, "%s.tmp", pathname);
+    file = safe_fopen(temp_pathname, "wb");
+    header[H_S] = cache->s;
+    header[H_E] = cache->E;
+    header[H_B] = cache->b;
+    header[H_TAG_SIZE] = tag_size;
+    header[H_HIT] = count->hit;
+    header[H_MISS] = count->miss;
+    header[H_EVICTION] = count->eviction;
+    header[H_OFFSET] = offset;
+    if (fwrite(magic, sizeof(magic), 1, file) != 1)
+        err(EXIT_FAILURE, "%s", temp_pathname);
+    write_words(file, temp_pathname, header, H_LENGTH);
+    if (fwrite(cache->fills, sizeof(uint32_t), cache->S, file) != cache->S)
+        err(EXIT_FAILURE, "%s", temp_pathname);
+    for (i = 0; i < cache->S; ++i) {
+        if (fwrite((char *)cache->tags + i * cache->E * tag_size, tag_size,
+                   cache->fills[i], file) != cache->fills[i])
+            err(EXIT_FAILURE, "%s", temp_pathname);
+    }
+    if (fclose(file) || rename(temp_pathname, pathname))
+        err(EXIT_FAILURE, "%s", pathname);
+    safe_free((void **)&temp_pathname);
+}
+
+/*
+ * Tags saved narrower than the cache's own are widened one by one; wider
+ * ones widen the cache first.
+ */
+static void read_tags(FILE *file, const char *pathname, t_cache *cache,
+                      size_t tag_size) {
+    size_t E = cache->E;
+    uint32_t tag;
+    size_t i, j;
+
+    if (tag_size != sizeof(uint32_t) && tag_size != sizeof(uint64_t))
+        errx(EXIT_FAILURE, "%s: Invalid tag size %zu", pathname, tag_size);
+    if (tag_size > cache->tag_size)
+        widen_tags(cache);
+    for (i = 0; i < cache->S; ++i) {
+        if (cache->fills[i] > E)
+            errx(EXIT_FAILURE, "%s: Invalid set fill", pathname);
+        if (tag_size == cache->tag_size) {
+            if (fread((char *)cache->tags + i * E * tag_size, tag_size,
+                      cache->fills[i], file) != cache->fills[i])
+                errx(EXIT_FAILURE, "%s: Truncated checkpoint", pathname);
+            continue;
+        }
+        for (j = 0; j < cache->fills[i]; ++j) {
+            if (fread(&tag, sizeof(tag), 1, file) != 1)
+                errx(EXIT_FAILURE, "%s: Truncated checkpoint", pathname);
+            set_tag(cache, i * E + j, tag);
+        }
+    }
+}
+
+static void read_words(FILE *file, const char *pathname, uint64_t *words,
+                       size_t n) {
+    if (fread(words, sizeof(*words), n, file) != n)
+        errx(EXIT_FAILURE, "%s: Truncated checkpoint", pathname);
+}
+
+static void write_words(FILE *file, const char *pathname,
+                        const uint64_t *words, size_t n) {
+    if (fwrite(words, sizeof(*words), n, file) != n)
+        err(EXIT_FAILURE, "%s", pathname);
+}
@@ -0,0 +1,11 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "csim.h"
+
+void load_checkpoint(const char *pathname, t_cache *cache, t_count *count,
+                     long *offset);
+void save_checkpoint(const char *pathname, const t_cache *cache,
+                     const t_count *count, long offset);
+
+#endif
@@ -1,10 +1,17 @@
 #include "csim.h"
 
+#include <err.h>
+
 #include "cachelab.h"
+#include "checkpoint.h"
+#include "parallel.h"
+#include "trace.h"
 #include "utils.h"
 
 static const char *usage_format =
-    "Usage: %s [-hv] -s <num> -E <num> -b <num> -t <file>\n"
+    "Usage: %s [-hv] -s <num> -E <num> -b <num> -t <file> [-j <num>] "
+    "[-H <num> -M <num> -O <num>] [-C <file> [-I <num>]] "
+    "[-R <file> | -W <file>]\n"
     "Options:\n"
     "  -h         Print this help message.\n"
     "  -v         Optional verbose flag.\n"
@@ -12,17 +19,28 @@ static const char *usage_format =
     "  -E <num>   Number of lines per set.\n"
     "  -b <num>   Number of block offset bits.\n"
     "  -t <file>  Trace file.\n"
+    "  -j <num>   Number of threads, each owning a range of sets "
+    "(default: 1).\n"
+    "  -H <num>   Hit latency in cycles (default: 1).\n"
+    "  -M <num>   Memory latency in cycles; enables the AMAT report.\n"
+    "  -O <num>   Overlapped misses in flight, at least 1 (default: 1).\n"
+    "  -C <file>  Save a checkpoint periodically and at the end of the trace.\n"
+    "  -I <num>   Records between checkpoints (default: 1000000).\n"
+    "  -R <file>  Resume from a checkpoint of the same trace.\n"
+    "  -W <file>  Start from the cache state of a checkpoint, with zero "
+    "counts.\n"
     "\n"
     "Examples:\n"
     "  linux>  %s -s 4 -E 1 -b 4 -t traces/yi.trace\n"
-    "  linux>  %s -v -s 8 -E 2 -b 4 -t traces/yi.trace\n";
+    "  linux>  %s -v -s 8 -E 2 -b 4 -t traces/yi.trace\n"
+    "  linux>  %s -s 8 -E 2 -b 4 -t traces/yi.trace -H 4 -M 200 -O 2\n"
+    "  linux>  %s -s 5 -E 1 -b 5 -t traces/long.trace -C long.ckpt\n"
+    "  linux>  %s -s 16 -E 8 -b 6 -t traces/long.trace -j 4\n";
 
-static const char *access_memory(uint64_t address, t_cache *cache,
-                                 t_count *count);
-static void free_cache(t_cache *cache);
-static void init_cache(t_option *option, t_cache *cache);
 static void parse_arguments(int argc, char *const argv[], t_option *option);
+static void print_timing(t_option *option, t_count *count);
 static void print_usage_and_exit(const char *program_name, int exit_code);
+static void restore_cache(t_option *option, t_cache *cache, t_count *count);
 static void simulate(t_option *option, t_cache *cache, t_count *count);
 
 int main(int argc, char *argv[]) {
@@ -31,82 +49,25 @@ int main(int argc, char *argv[]) {
     t_cache cache;
 
     parse_arguments(argc, argv, &option);
-    init_cache(&option, &cache);
+    init_cache(&cache, option.s, option.E, option.b);
+    restore_cache(&option, &cache, &count);
     simulate(&option, &cache, &count);
     printSummary(count.hit, count.miss, count.eviction);
+    if (option.M > 0)
+        print_timing(&option, &count);
     free_cache(&cache);
     return EXIT_SUCCESS;
 }
 
-static const char *access_memory(uint64_t address, t_cache *cache,
-                                 t_count *count) {
-    const char *result = "miss";
-    t_line *target_line = NULL;
-    size_t E = cache->E;
-    uint64_t tag = address >> (cache->s + cache->b);
-    uint64_t set_index = (address >> cache->b) & ((1 << cache->s) - 1);
-    t_set *set = &cache->sets[set_index];
-    t_line *lru_line = &set->lines[0];
-    t_line *line;
-    size_t i;
-
-    cache->access_count += 1;
-    for (i = 0; i < E; ++i) {
-        line = &set->lines[i];
-        if (line->is_valid && line->tag == tag) {
-            line->last_used = cache->access_count;
-            count->hit += 1;
-            return "hit";
-        }
-        if (target_line)
-            continue;
-        if (!line->is_valid)
-            target_line = line;
-        if (line->last_used < lru_line->last_used)
-            lru_line = line;
-    }
-    count->miss += 1;
-    if (!target_line) {
-        target_line = lru_line;
-        count->eviction += 1;
-        result = "miss eviction";
-    }
-    target_line->is_valid = true;
-    target_line->tag = tag;
-    target_line->last_used = cache->access_count;
-    return result;
-}
-
-static void free_cache(t_cache *cache) {
-    t_set *sets = cache->sets;
-    size_t S = cache->S;
-    size_t i;
-
-    for (i = 0; i < S; ++i)
-        safe_free((void **)&sets[i].lines);
-    safe_free((void **)&sets);
-}
-
-static void init_cache(t_option *option, t_cache *cache) {
-    t_set *sets;
-    size_t E, S;
-    size_t i;
-
-    cache->access_count = 0;
-    E = cache->E = option->E;
-    cache->b = option->b;
-    cache->s = option->s;
-    S = cache->S = 1 << option->s;
-    sets = cache->sets = (t_set *)safe_calloc(S, sizeof(t_set));
-    for (i = 0; i < S; ++i)
-        sets[i].lines = (t_line *)safe_calloc(E, sizeof(t_line));
-}
-
 static void parse_arguments(int argc, char *const argv[], t_option *option) {
     const char *program_name = argv[0];
     int opt;
 
-    while ((opt = getopt(argc, argv, "hvs:E:b:t:")) != -1) {
+    option->H = 1;
+    option->O = 1;
+    option->I = 1000000;
+    option->j = 1;
+    while ((opt = getopt(argc, argv, "hvs:E:b:t:j:H:M:O:C:I:R:W:")) != -1) {
         switch (opt) {
         case 'h':
             print_usage_and_exit(program_name, EXIT_SUCCESS);
@@ -125,6 +86,30 @@ static void parse_arguments(int argc, char *const argv[], t_option *option) {
         case 't':
             option->t = optarg;
             break;
+        case 'j':
+            option->j = atoi(optarg);
+            break;
+        case 'H':
+            option->H = atof(optarg);
+            break;
+        case 'M':
+            option->M = atof(optarg);
+            break;
+        case 'O':
+            option->O = atof(optarg);
+            break;
+        case 'C':
+            option->C = optarg;
+            break;
+        case 'I':
+            option->I = atoi(optarg);
+            break;
+        case 'R':
+            option->R = optarg;
+            break;
+        case 'W':
+            option->W = optarg;
+            break;
         default:
             print_usage_and_exit(program_name, EXIT_FAILURE);
         }
@@ -134,35 +119,101 @@ static void parse_arguments(int argc, char *const argv[], t_option *option) {
                 program_name);
         print_usage_and_exit(program_name, EXIT_FAILURE);
     }
+    if (option->j <= 0 || (option->j > 1 && option->v)) {
+        fprintf(stderr, "%s: Invalid thread count\n", program_name);
+        print_usage_and_exit(program_name, EXIT_FAILURE);
+    }
+    if (option->H < 0 || option->M < 0 || option->O < 1) {
+        fprintf(stderr, "%s: Invalid latency or overlap argument\n",
+                program_name);
+        print_usage_and_exit(program_name, EXIT_FAILURE);
+    }
+    if (option->I <= 0 || (option->R && option->W)) {
+        fprintf(stderr, "%s: Invalid checkpoint arguments\n", program_name);
+        print_usage_and_exit(program_name, EXIT_FAILURE);
+    }
     option->trace_file = safe_fopen(option->t, "r");
 }
 
+/*
+ * Every access pays the hit latency; a miss additionally waits for memory,
+ * but up to `O` misses are assumed to overlap, which divides their stall.
+ */
+static void print_timing(t_option *option, t_count *count) {
+    size_t accesses = count->hit + count->miss;
+    double stall_cycles = count->miss * option->M / option->O;
+    double amat = option->H;
+
+    if (accesses)
+        amat += stall_cycles / accesses;
+    printf("amat:%.2f stall_cycles:%.0f total_cycles:%.0f\n", amat,
+           stall_cycles, accesses * option->H + stall_cycles);
+}
+
 static void print_usage_and_exit(const char *program_name, int exit_code) {
     FILE *stream = exit_code == EXIT_SUCCESS ? stdout : stderr;
 
-    fprintf(stream, usage_format, program_name, program_name, program_name);
+    fprintf(stream, usage_format, program_name, program_name, program_name,
+            program_name, program_name, program_name);
     exit(exit_code);
 }
 
+/*
+ * Resuming continues the same trace where the checkpoint left off. Warming
+ * keeps only the cache contents, so that a second trace is measured against
+ * the state left by the first one.
+ */
+static void restore_cache(t_option *option, t_cache *cache, t_count *count) {
+    t_count warm_count;
+    long offset;
+
+    if (option->R) {
+        load_checkpoint(option->R, cache, count, &offset);
+        if (fseek(option->trace_file, offset, SEEK_SET))
+            err(EXIT_FAILURE, "%s", option->t);
+    } else if (option->W) {
+        load_checkpoint(option->W, cache, &warm_count, &offset);
+    }
+}
+
+/*
+ * With more than one thread, the records are handed to the workers and the
+ * counts only become exact after the pool is synchronized.
+ */
 static void simulate(t_option *option, t_cache *cache, t_count *count) {
-    FILE *trace_file = option->trace_file;
-    char operation;
-    uint64_t address;
-    size_t size;
+    t_trace trace;
+    t_record record;
+    t_pool pool;
     const char *result;
-
-    while (fscanf(trace_file, " %c %lx,%zu", &operation, &address, &size) == 3) {
-        if (operation == 'I')
-            continue;
-        if (operation == 'M')
-            count->hit += 1;
-        result = access_memory(address, cache, count);
-        if (option->v) {
-            printf("%c %lx,%zu %s", operation, address, size, result);
-            if (operation == 'M')
-                printf(" hit");
-            printf(" \n");
+    size_t records = 0;
+
+    /* Per-access results are only needed in verbose mode. */
+    init_trace(&trace, option->trace_file, cache->b, !option->v);
+    if (option->j > 1)
+        init_pool(&pool, cache, option->j);
+    while (read_record(&trace, &record)) {
+        if (option->j > 1) {
+            dispatch_record(&pool, &record);
+        } else {
+            result = access_memory(record.address, cache, count);
+            count->hit += record.hits;
+            if (option->v) {
+                printf("%c %lx,%zu %s", record.operation, record.address,
+                       record.size, result);
+                if (record.operation == 'M')
+                    printf(" hit");
+                printf(" \n");
+            }
+        }
+        if (option->C && ++records % option->I == 0) {
+            if (option->j > 1)
+                sync_pool(&pool, count);
+            save_checkpoint(option->C, cache, count, trace.offset);
         }
     }
-    fclose(trace_file);
+    if (option->j > 1)
+        join_pool(&pool, count);
+    if (option->C)
+        save_checkpoint(option->C, cache, count, trace.offset);
+    close_trace(&trace);
 }
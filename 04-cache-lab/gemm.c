@@ -0,0 +1,253 @@
+/*
+ * gemm.c - Matrix multiply C = A x B
+ *
+ * Each multiply function must have a prototype of the form:
+ * void gemm(int M, int N, int K, double A[M][K], double B[K][N],
+ *           double C[M][N]);
+ *
+ * It overwrites C with the product of the M x K matrix A and the K x N
+ * matrix B. The functions are evaluated by test-gemm on the same cache
+ * model as the transposes, and timed by bench-gemm.
+ */
+#include "cachelab.h"
+
+/* Blocks of the blocked multiply: one block each of A, B and C, 24KB in
+   all, fit a 32KB L1d */
+#define GEMM_BLOCK 32
+
+/* Register tile of the micro-kernel, kept in 16 accumulators */
+#define MICRO_ROWS 4
+#define MICRO_COLS 4
+
+/* Rows of B that the register-tiled multiply streams through per pass */
+#define PANEL_DEPTH 128
+
+static void gemm_micro(int M, int N, int K, double A[M][K], double B[K][N],
+                       double C[M][N], int i0, int j0, int k0, int k_end);
+static void gemm_micro_edge(int M, int N, int K, double A[M][K],
+                            double B[K][N], double C[M][N], int i0, int j0,
+                            int k0, int k_end);
+
+/*
+ * gemm_naive - The textbook i-j-k multiply. The innermost loop walks B
+ *     down a column, touching a new line for every multiply-add.
+ */
+char gemm_naive_desc[] = "Naive i-j-k multiply";
+void gemm_naive(int M, int N, int K, double A[M][K], double B[K][N],
+                double C[M][N])
+{
+    int i, j, k;
+    double sum;
+
+    for (i = 0; i < M; i++) {
+        for (j = 0; j < N; j++) {
+            sum = 0;
+            for (k = 0; k < K; k++)
+                sum += A[i][k] * B[k][j];
+            C[i][j] = sum;
+        }
+    }
+}
+
+/*
+ * gemm_interchanged - The i-k-j order: the innermost loop walks rows of
+ *     B and C, so every line it touches is used in full
+ */
+char gemm_interchanged_desc[] = "Loop-interchanged i-k-j multiply";
+void gemm_interchanged(int M, int N, int K, double A[M][K], double B[K][N],
+                       double C[M][N])
+{
+    int i, j, k;
+    double a;
+
+    for (i = 0; i < M; i++) {
+        for (j = 0; j < N; j++)
+            C[i][j] = 0;
+        for (k = 0; k < K; k++) {
+            a = A[i][k];
+            for (j = 0; j < N; j++)
+                C[i][j] += a * B[k][j];
+        }
+    }
+}
+
+/*
+ * gemm_blocked - The i-k-j order within GEMM_BLOCK x GEMM_BLOCK blocks,
+ *     so that a block of B is reused by a whole block of rows of A
+ *     before it leaves the cache
+ */
+char gemm_blocked_desc[] = "Blocked i-k-j multiply";
+void gemm_blocked(int M, int N, int K, double A[M][K], double B[K][N],
+                  double C[M][N])
+{
+    int i0, j0, k0, i, j, k, i_end, j_end, k_end;
+    double a;
+
+    for (i = 0; i < M; i++)
+        for (j = 0; j < N; j++)
+            C[i][j] = 0;
+    for (i0 = 0; i0 < M; i0 += GEMM_BLOCK) {
+        i_end = i0 + GEMM_BLOCK < M ? i0 + GEMM_BLOCK : M;
+        for (k0 = 0; k0 < K; k0 += GEMM_BLOCK) {
+            k_end = k0 + GEMM_BLOCK < K ? k0 + GEMM_BLOCK : K;
+            for (j0 = 0; j0 < N; j0 += GEMM_BLOCK) {
+                j_end = j0 + GEMM_BLOCK < N ? j0 + GEMM_BLOCK : N;
+                for (i = i0; i < i_end; i++) {
+                    for (k = k0; k < k_end; k++) {
+                        a = A[i][k];
+                        for (j = j0; j < j_end; j++)
+                            C[i][j] += a * B[k][j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+ * gemm_register_tiled - Each MICRO_ROWS x MICRO_COLS tile of C is
+ *     accumulated in registers by gemm_micro, over PANEL_DEPTH rows of B
+ *     at a time, so C is only loaded and stored once per panel
+ */
+char gemm_register_tiled_desc[] = "Register-tiled 4x4 micro-kernel multiply";
+void gemm_register_tiled(int M, int N, int K, double A[M][K],
+                         double B[K][N], double C[M][N])
+{
+    int i0, j0, k0, k_end, i, j;
+
+    /* With no panels, the product is all zeros */
+    if (K == 0) {
+        for (i = 0; i < M; i++)
+            for (j = 0; j < N; j++)
+                C[i][j] = 0;
+        return;
+    }
+    for (k0 = 0; k0 < K; k0 += PANEL_DEPTH) {
+        k_end = k0 + PANEL_DEPTH < K ? k0 + PANEL_DEPTH : K;
+        for (i0 = 0; i0 < M; i0 += MICRO_ROWS)
+            for (j0 = 0; j0 < N; j0 += MICRO_COLS)
+                gemm_micro(M, N, K, A, B, C, i0, j0, k0, k_end);
+    }
+}
+
+/*
+ * gemm_micro - Add the product of rows i0.. of A and columns j0.. of B,
+ *     over k0..k_end, to the tile of C at (i0, j0), or store it there
+ *     for the first panel. The 16 sums of a whole tile are kept in
+ *     scalars, which the compiler can hold in registers; tiles cut short
+ *     at the edges of C go to gemm_micro_edge.
+ */
+static void gemm_micro(int M, int N, int K, double A[M][K], double B[K][N],
+                       double C[M][N], int i0, int j0, int k0, int k_end)
+{
+    double c00, c01, c02, c03, c10, c11, c12, c13;
+    double c20, c21, c22, c23, c30, c31, c32, c33;
+    double a0, a1, a2, a3, b0, b1, b2, b3;
+    int k;
+
+    if (M - i0 < MICRO_ROWS || N - j0 < MICRO_COLS) {
+        gemm_micro_edge(M, N, K, A, B, C, i0, j0, k0, k_end);
+        return;
+    }
+    if (k0 == 0) {
+        c00 = c01 = c02 = c03 = c10 = c11 = c12 = c13 = 0;
+        c20 = c21 = c22 = c23 = c30 = c31 = c32 = c33 = 0;
+    } else {
+        c00 = C[i0][j0];
+        c01 = C[i0][j0 + 1];
+        c02 = C[i0][j0 + 2];
+        c03 = C[i0][j0 + 3];
+        c10 = C[i0 + 1][j0];
+        c11 = C[i0 + 1][j0 + 1];
+        c12 = C[i0 + 1][j0 + 2];
+        c13 = C[i0 + 1][j0 + 3];
+        c20 = C[i0 + 2][j0];
+        c21 = C[i0 + 2][j0 + 1];
+        c22 = C[i0 + 2][j0 + 2];
+        c23 = C[i0 + 2][j0 + 3];
+        c30 = C[i0 + 3][j0];
+        c31 = C[i0 + 3][j0 + 1];
+        c32 = C[i0 + 3][j0 + 2];
+        c33 = C[i0 + 3][j0 + 3];
+    }
+    for (k = k0; k < k_end; k++) {
+        a0 = A[i0][k];
+        a1 = A[i0 + 1][k];
+        a2 = A[i0 + 2][k];
+        a3 = A[i0 + 3][k];
+        b0 = B[k][j0];
+        b1 = B[k][j0 + 1];
+        b2 = B[k][j0 + 2];
+        b3 = B[k][j0 + 3];
+        c00 += a0 * b0;
+        c01 += a0 * b1;
+        c02 += a0 * b2;
+        c03 += a0 * b3;
+        c10 += a1 * b0;
+        c11 += a1 * b1;
+        c12 += a1 * b2;
+        c13 += a1 * b3;
+        c20 += a2 * b0;
+        c21 += a2 * b1;
+        c22 += a2 * b2;
+        c23 += a2 * b3;
+        c30 += a3 * b0;
+        c31 += a3 * b1;
+        c32 += a3 * b2;
+        c33 += a3 * b3;
+    }
+    C[i0][j0] = c00;
+    C[i0][j0 + 1] = c01;
+    C[i0][j0 + 2] = c02;
+    C[i0][j0 + 3] = c03;
+    C[i0 + 1][j0] = c10;
+    C[i0 + 1][j0 + 1] = c11;
+    C[i0 + 1][j0 + 2] = c12;
+    C[i0 + 1][j0 + 3] = c13;
+    C[i0 + 2][j0] = c20;
+    C[i0 + 2][j0 + 1] = c21;
+    C[i0 + 2][j0 + 2] = c22;
+    C[i0 + 2][j0 + 3] = c23;
+    C[i0 + 3][j0] = c30;
+    C[i0 + 3][j0 + 1] = c31;
+    C[i0 + 3][j0 + 2] = c32;
+    C[i0 + 3][j0 + 3] = c33;
+}
+
+/*
+ * gemm_micro_edge - gemm_micro for a tile cut short at the edges of C
+ */
+static void gemm_micro_edge(int M, int N, int K, double A[M][K],
+                            double B[K][N], double C[M][N], int i0, int j0,
+                            int k0, int k_end)
+{
+    double c[MICRO_ROWS][MICRO_COLS] = {{0}};
+    int rows = M - i0 < MICRO_ROWS ? M - i0 : MICRO_ROWS;
+    int cols = N - j0 < MICRO_COLS ? N - j0 : MICRO_COLS;
+    int i, j, k;
+
+    for (k = k0; k < k_end; k++)
+        for (i = 0; i < rows; i++)
+            for (j = 0; j < cols; j++)
+                c[i][j] += A[i0 + i][k] * B[k][j0 + j];
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            if (k0 > 0)
+                c[i][j] += C[i0 + i][j0 + j];
+            C[i0 + i][j0 + j] = c[i][j];
+        }
+    }
+}
+
+/*
+ * registerGemmFunctions - This function registers your multiply
+ *     functions with the driver. At runtime, the driver will evaluate
+ *     each of the registered functions and summarize their performance.
+ */
+void registerGemmFunctions()
+{
+    registerGemmFunction(gemm_naive, gemm_naive_desc);
+    registerGemmFunction(gemm_interchanged, gemm_interchanged_desc);
+    registerGemmFunction(gemm_blocked, gemm_blocked_desc);
+    registerGemmFunction(gemm_register_tiled, gemm_register_tiled_desc);
+}
@@ -0,0 +1,284 @@
+#include <err.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "utils.h"
+
+/* Same bound as test-trans */
+#define MAXN 256
+#define MAX_REGISTERS 32
+
+typedef struct s_option {
+    int rows, cols;
+    int T, r;
+    const char *o;
+} t_option;
+
+/* One kernel to emit: an M x N transpose in rows x cols blocks of A */
+typedef struct s_kernel {
+    int M, N;
+    int rows, cols;
+} t_kernel;
+
+static const char *usage_format =
+    "Usage: %s [-h] [-B <rows>x<cols>] [-T <bytes>] [-r <num>] [-o <file>]\n"
+    "          <M>x<N>[:<rows>x<cols>]...\n"
+    "Options:\n"
+    "  -h                Print this help message.\n"
+    "  -B <rows>x<cols>  Block shape in elements of A (default: 8x8),\n"
+    "                    unless a kernel gives its own after a colon.\n"
+    "  -T <bytes>        Element size: 1, 2, 4 or 8 (default: 4).\n"
+    "  -r <num>          Temporaries a block row is loaded into "
+    "(default: 8).\n"
+    "  -o <file>         Write the kernels to a file instead of stdout.\n"
+    "\n"
+    "Examples:\n"
+    "  linux>  %s 32x32\n"
+    "  linux>  %s -r 12 -o trans-gen.h 32x32 64x64:8x4 61x67:16x4\n";
+
+static void emit_block(FILE *stream, const t_option *option,
+                       const t_kernel *kernel, int r0, int c0);
+static void emit_kernel(FILE *stream, const t_option *option,
+                        const t_kernel *kernel);
+static void emit_registration(FILE *stream, const t_option *option,
+                              const t_kernel *kernels, size_t length);
+static const char *element_type(int size);
+static void kernel_name(const t_option *option, const t_kernel *kernel,
+                        char *name, size_t size);
+static void parse_arguments(int argc, char *const argv[], t_option *option);
+static void parse_kernel(const char *program_name, const char *arg,
+                         const t_option *option, t_kernel *kernel);
+static void print_usage_and_exit(const char *program_name, int exit_code);
+
+int main(int argc, char *argv[]) {
+    t_option option = {0};
+    t_kernel *kernels;
+    FILE *stream = stdout;
+    size_t i, length;
+    int j;
+
+    parse_arguments(argc, argv, &option);
+    length = argc - optind;
+    kernels = safe_calloc(length, sizeof(t_kernel));
+    for (i = 0; i < length; i++)
+        parse_kernel(argv[0], argv[optind + i], &option, &kernels[i]);
+    if (option.o)
+        stream = safe_fopen(option.o, "w");
+    fprintf(stream, "/*\n"
+                    " * Unrolled transposes emitted by gen-trans, for "
+                    "REGISTER_GENERATED_TRANSPOSES()\n"
+                    " *\n"
+                    " * Generated by:");
+    for (j = 0; j < argc; j++)
+        fprintf(stream, " %s", argv[j]);
+    fprintf(stream, "\n */\n");
+    for (i = 0; i < length; i++)
+        emit_kernel(stream, &option, &kernels[i]);
+    emit_registration(stream, &option, kernels, length);
+    if (stream != stdout && fclose(stream))
+        err(EXIT_FAILURE, "%s", option.o);
+    safe_free((void **)&kernels);
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Each row of the block is loaded into temporaries before any of it is
+ * stored, so that the stores into B cannot evict the line of A still
+ * being read. A row wider than the temporaries goes in chunks; on a
+ * block that holds part of the diagonal, the diagonal element is kept
+ * in the last temporary and stored after the rest of its row, as in
+ * transpose_tile.
+ */
+static void emit_block(FILE *stream, const t_option *option,
+                       const t_kernel *kernel, int r0, int c0) {
+    int r_end = r0 + kernel->rows < kernel->N ? r0 + kernel->rows : kernel->N;
+    int c_end = c0 + kernel->cols < kernel->M ? c0 + kernel->cols : kernel->M;
+    int r, c, c_chunk, chunk, t, diagonal;
+
+    fprintf(stream, "    /* A[%d..%d][%d..%d] */\n", r0, r_end - 1, c0,
+            c_end - 1);
+    for (r = r0; r < r_end; r++) {
+        diagonal = r >= c0 && r < c_end && c_end - c0 > option->r;
+        chunk = diagonal ? option->r - 1 : option->r;
+        for (c_chunk = c0; c_chunk < c_end; c_chunk += chunk) {
+            fprintf(stream, "   ");
+            for (c = c_chunk, t = 0; c < c_chunk + chunk && c < c_end; c++) {
+                if (diagonal && c == r)
+                    fprintf(stream, " t%d = A[%d][%d];", option->r - 1, r, c);
+                else
+                    fprintf(stream, " t%d = A[%d][%d];", t++, r, c);
+            }
+            fprintf(stream, "\n   ");
+            for (c = c_chunk, t = 0; c < c_chunk + chunk && c < c_end; c++) {
+                if (!(diagonal && c == r))
+                    fprintf(stream, " B[%d][%d] = t%d;", c, r, t++);
+            }
+            fprintf(stream, "\n");
+        }
+        if (diagonal)
+            fprintf(stream, "    B[%d][%d] = t%d;\n", r, r, option->r - 1);
+    }
+}
+
+/*
+ * The kernel is only unrolled for its own shape; any other shape takes
+ * a plain scan, so the kernel stays correct wherever it is registered.
+ */
+static void emit_kernel(FILE *stream, const t_option *option,
+                        const t_kernel *kernel) {
+    const char *type = element_type(option->T);
+    char name[64];
+    int r0, c0, t, temps;
+
+    kernel_name(option, kernel, name, sizeof(name));
+    fprintf(stream, "\n/*\n"
+                    " * %s - %dx%d of %d-byte elements in %dx%d blocks,\n"
+                    " *     with %d temporaries\n"
+                    " */\n",
+            name, kernel->M, kernel->N, option->T, kernel->rows,
+            kernel->cols, option->r);
+    fprintf(stream,
+            "char %s_desc[] = \"Generated %dx%d transpose, %dx%d blocks\";\n",
+            name, kernel->M, kernel->N, kernel->rows, kernel->cols);
+    if (option->T == sizeof(int)) {
+        fprintf(stream,
+                "static void %s(int M, int N, int A[N][M], int B[M][N])\n"
+                "{\n",
+                name);
+    } else {
+        fprintf(stream,
+                "static void %s(int M, int N, void *a, void *b)\n"
+                "{\n"
+                "    %s (*A)[M] = a;\n"
+                "    %s (*B)[N] = b;\n",
+                name, type, type);
+    }
+    /* Only the temporaries the widest block row needs */
+    temps = kernel->cols < kernel->M ? kernel->cols : kernel->M;
+    if (temps > option->r)
+        temps = option->r;
+    fprintf(stream, "    %s", type);
+    for (t = 0; t < temps; t++)
+        fprintf(stream, "%s t%d", t ? "," : "", t);
+    fprintf(stream, ";\n"
+                    "    int r, c;\n"
+                    "\n"
+                    "    if (M != %d || N != %d) {\n"
+                    "        for (r = 0; r < N; ++r)\n"
+                    "            for (c = 0; c < M; ++c)\n"
+                    "                B[c][r] = A[r][c];\n"
+                    "        return;\n"
+                    "    }\n",
+            kernel->M, kernel->N);
+    for (r0 = 0; r0 < kernel->N; r0 += kernel->rows)
+        for (c0 = 0; c0 < kernel->M; c0 += kernel->cols)
+            emit_block(stream, option, kernel, r0, c0);
+    fprintf(stream, "}\n");
+}
+
+static void emit_registration(FILE *stream, const t_option *option,
+                              const t_kernel *kernels, size_t length) {
+    char name[64];
+    size_t i;
+
+    fprintf(stream, "\n#define REGISTER_GENERATED_TRANSPOSES() \\\n"
+                    "    do { \\\n");
+    for (i = 0; i < length; i++) {
+        kernel_name(option, &kernels[i], name, sizeof(name));
+        if (option->T == sizeof(int))
+            fprintf(stream, "        registerTransFunction(%s, %s_desc); \\\n",
+                    name, name);
+        else
+            fprintf(stream,
+                    "        registerTypedTransFunction(%s, %d, %s_desc); \\\n",
+                    name, option->T, name);
+    }
+    fprintf(stream, "    } while (0)\n");
+}
+
+static const char *element_type(int size) {
+    switch (size) {
+    case 1:
+        return "int8_t";
+    case 2:
+        return "int16_t";
+    case 4:
+        return "int";
+    default:
+        return "int64_t";
+    }
+}
+
+static void kernel_name(const t_option *option, const t_kernel *kernel,
+                        char *name, size_t size) {
+    if (option->T == sizeof(int))
+        snprintf(name, size, "transpose_gen_%dx%d", kernel->M, kernel->N);
+    else
+        snprintf(name, size, "transpose_gen_%dx%d_%d", kernel->M, kernel->N,
+                 option->T * 8);
+}
+
+static void parse_arguments(int argc, char *const argv[], t_option *option) {
+    const char *program_name = argv[0];
+    char rest;
+    int opt;
+
+    option->rows = option->cols = 8;
+    option->T = sizeof(int);
+    option->r = 8;
+    while ((opt = getopt(argc, argv, "hB:T:r:o:")) != -1) {
+        switch (opt) {
+        case 'h':
+            print_usage_and_exit(program_name, EXIT_SUCCESS);
+        case 'B':
+            if (sscanf(optarg, "%dx%d%c", &option->rows, &option->cols,
+                       &rest) != 2)
+                option->rows = 0;
+            break;
+        case 'T':
+            option->T = atoi(optarg);
+            break;
+        case 'r':
+            option->r = atoi(optarg);
+            break;
+        case 'o':
+            option->o = optarg;
+            break;
+        default:
+            print_usage_and_exit(program_name, EXIT_FAILURE);
+        }
+    }
+    if (option->rows <= 0 || option->cols <= 0 ||
+        (option->T != 1 && option->T != 2 && option->T != 4 &&
+         option->T != 8) ||
+        option->r < 2 || option->r > MAX_REGISTERS || optind >= argc) {
+        fprintf(stderr, "%s: Missing or invalid command line argument\n",
+                program_name);
+        print_usage_and_exit(program_name, EXIT_FAILURE);
+    }
+}
+
+static void parse_kernel(const char *program_name, const char *arg,
+                         const t_option *option, t_kernel *kernel) {
+    char rest;
+    int fields;
+
+    kernel->rows = option->rows;
+    kernel->cols = option->cols;
+    fields = sscanf(arg, "%dx%d:%dx%d%c", &kernel->M, &kernel->N,
+                    &kernel->rows, &kernel->cols, &rest);
+    if ((fields != 2 && fields != 4) || kernel->M <= 0 || kernel->N <= 0 ||
+        kernel->M > MAXN || kernel->N > MAXN || kernel->rows <= 0 ||
+        kernel->cols <= 0) {
+        fprintf(stderr, "%s: Invalid kernel %s\n", program_name, arg);
+        print_usage_and_exit(program_name, EXIT_FAILURE);
+    }
+}
+
+static void print_usage_and_exit(const char *program_name, int exit_code) {
+    FILE *stream = exit_code == EXIT_SUCCESS ? stdout : stderr;
+
+    fprintf(stream, usage_format, program_name, program_name, program_name);
+    exit(exit_code);
+}
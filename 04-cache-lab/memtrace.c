@@ -0,0 +1,106 @@
+#include "memtrace.h"
+
+#include <sys/resource.h>
+
+#include "utils.h"
+
+#define MIN_CAPACITY 4096
+#define DEFAULT_STACK_LIMIT (8 << 20)
+
+#define DEFINE_HOOKS(n)                                                        \
+    void __tsan_read##n(void *address) { record_access('L', address, n); }     \
+    void __tsan_write##n(void *address) { record_access('S', address, n); }    \
+    void __tsan_unaligned_read##n(void *address) {                             \
+        record_access('L', address, n);                                        \
+    }                                                                          \
+    void __tsan_unaligned_write##n(void *address) {                            \
+        record_access('S', address, n);                                        \
+    }
+
+static t_memtrace *recording;
+
+void free_memtrace(t_memtrace *trace) {
+    safe_free((void **)&trace->records);
+    trace->length = trace->capacity = 0;
+}
+
+bool is_stack_access(const t_memtrace *trace, const t_record *record) {
+    return trace->stack_low <= record->address &&
+           record->address < trace->stack_high;
+}
+
+void record_access(char operation, const volatile void *address, size_t size) {
+    t_memtrace *trace = recording;
+    t_record *record;
+
+    if (!trace)
+        return;
+    if (trace->length == trace->capacity && trace->drain) {
+        trace->drain(trace, trace->context);
+        trace->length = 0;
+    } else if (trace->length == trace->capacity) {
+        trace->capacity =
+            trace->capacity ? trace->capacity * 2 : MIN_CAPACITY;
+        trace->records = (t_record *)safe_realloc(
+            trace->records, trace->capacity * sizeof(t_record));
+    }
+    record = &trace->records[trace->length++];
+    record->operation = operation;
+    record->address = (uintptr_t)address;
+    record->size = size;
+    record->hits = 0;
+}
+
+/*
+ * Everything the traced code touches on the stack lies below the caller's
+ * frame, within the stack size limit.
+ */
+void start_memtrace(t_memtrace *trace) {
+    struct rlimit limit;
+    uintptr_t stack_limit = DEFAULT_STACK_LIMIT;
+
+    if (!getrlimit(RLIMIT_STACK, &limit) && limit.rlim_cur != RLIM_INFINITY)
+        stack_limit = limit.rlim_cur;
+    trace->length = 0;
+    trace->stack_high = (uintptr_t)__builtin_frame_address(0);
+    trace->stack_low = trace->stack_high - stack_limit;
+    recording = trace;
+}
+
+void stop_memtrace(void) {
+    t_memtrace *trace = recording;
+
+    recording = NULL;
+    if (trace && trace->drain && trace->length) {
+        trace->drain(trace, trace->context);
+        trace->length = 0;
+    }
+}
+
+void stream_memtrace(t_memtrace *trace, size_t capacity, t_drain drain,
+                     void *context) {
+    trace->records = (t_record *)safe_realloc(trace->records,
+                                              capacity * sizeof(t_record));
+    trace->length = 0;
+    trace->capacity = capacity;
+    trace->drain = drain;
+    trace->context = context;
+}
+
+void __tsan_init(void) {}
+void __tsan_func_entry(void *return_address) {}
+void __tsan_func_exit(void) {}
+
+DEFINE_HOOKS(1)
+DEFINE_HOOKS(2)
+DEFINE_HOOKS(4)
+DEFINE_HOOKS(8)
+DEFINE_HOOKS(16)
+
+void __tsan_read_range(void *address, size_t size) {
+    record_access('L', address, size);
+}
+
+void __tsan_write_range(void *address, size_t size) {
+    record_access('S', address, size);
+}
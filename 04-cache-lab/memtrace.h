@@ -0,0 +1,40 @@
+#ifndef MEMTRACE_H
+#define MEMTRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "trace.h"
+
+/*
+ * An in-memory trace of the loads and stores made by code compiled with
+ * -fsanitize=thread. Only the compiler's instrumentation is used: this
+ * module provides the __tsan_* hooks itself, so the ThreadSanitizer
+ * runtime is never linked in. Register-allocated locals are not
+ * instrumented, and stack accesses can be told apart with is_stack_access().
+ */
+typedef struct s_memtrace t_memtrace;
+typedef void (*t_drain)(t_memtrace *trace, void *context);
+
+/*
+ * Without a drain, records are kept until free_memtrace(). With one,
+ * records go to a ring of fixed capacity, which is handed to the drain
+ * and reused whenever it fills up, and once more by stop_memtrace().
+ */
+struct s_memtrace {
+    t_record *records;
+    size_t length, capacity;
+    uintptr_t stack_low, stack_high;
+    t_drain drain;
+    void *context;
+};
+
+void free_memtrace(t_memtrace *trace);
+bool is_stack_access(const t_memtrace *trace, const t_record *record);
+void record_access(char operation, const volatile void *address, size_t size);
+void start_memtrace(t_memtrace *trace);
+void stop_memtrace(void);
+void stream_memtrace(t_memtrace *trace, size_t capacity, t_drain drain,
+                     void *context);
+
+#endif
@@ -0,0 +1,242 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <err.h>
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cachelab.h"
+#include "utils.h"
+
+/* Matrices start on a line, as streaming stores want */
+#define MATRIX_ALIGNMENT 64
+
+typedef struct s_option {
+    int M, N;
+    int j, r;
+} t_option;
+
+/*
+ * One run of a parallel transpose, shared by the calling thread and the
+ * workers of the pool. Each run is bracketed by the two barriers.
+ */
+typedef struct s_job {
+    const par_trans_func_t *func;
+    int M, N;
+    int *A, *B;
+    int threads;
+    bool quit;
+    pthread_barrier_t start, finish;
+} t_job;
+
+typedef struct s_runner {
+    pthread_t thread;
+    t_job *job;
+    int id;
+} t_runner;
+
+static const char *usage_format =
+    "Usage: %s [-h] [-M <cols> -N <rows>] [-j <num>] [-r <num>]\n"
+    "Options:\n"
+    "  -h         Print this help message.\n"
+    "  -M <cols>  Number of matrix columns (default: 16384).\n"
+    "  -N <rows>  Number of matrix rows (default: 16384).\n"
+    "  -j <num>   Largest thread count (default: online CPUs).\n"
+    "  -r <num>   Timed runs per thread count, the best is kept "
+    "(default: 3).\n"
+    "\n"
+    "Examples:\n"
+    "  linux>  %s\n"
+    "  linux>  %s -M 32768 -N 8192 -j 16\n";
+
+/* External function defined in trans.c */
+extern void registerFunctions();
+
+/* External variables defined in cachelab.c */
+extern par_trans_func_t par_func_list[MAX_TRANS_FUNCS];
+extern int par_func_counter;
+
+static int *alloc_matrix(int rows, int cols);
+static void benchmark(const t_option *option, const par_trans_func_t *func,
+                      int *A);
+static bool check_transpose(const t_job *job);
+static double measure(t_job *job, const t_option *option);
+static void parse_arguments(int argc, char *const argv[], t_option *option);
+static void print_usage_and_exit(const char *program_name, int exit_code);
+static void run_share(t_job *job, int id);
+static void *run_worker(void *arg);
+
+int main(int argc, char *argv[]) {
+    t_option option = {0};
+    int *A;
+    size_t index;
+    int i;
+
+    parse_arguments(argc, argv, &option);
+    registerFunctions();
+    A = alloc_matrix(option.N, option.M);
+    /* Each element holds its index, wrapped to fit an int for matrices of
+       2^31 elements or more */
+    for (index = 0; index < (size_t)option.N * option.M; index++)
+        A[index] = (int)(index % ((size_t)INT_MAX + 1));
+    for (i = 0; i < par_func_counter; i++)
+        benchmark(&option, &par_func_list[i], A);
+    free(A);
+    return EXIT_SUCCESS;
+}
+
+static int *alloc_matrix(int rows, int cols) {
+    void *matrix;
+
+    if ((errno = posix_memalign(&matrix, MATRIX_ALIGNMENT,
+                                (size_t)rows * cols * sizeof(int))))
+        err(EXIT_FAILURE, "posix_memalign");
+    return (int *)matrix;
+}
+
+/*
+ * Thread counts double up to the largest one. B is allocated again for
+ * each count and first written by an untimed run, so that its pages land
+ * on the node of the thread that owns them.
+ */
+static void benchmark(const t_option *option, const par_trans_func_t *func,
+                      int *A) {
+    double bytes = 2.0 * option->M * option->N * sizeof(int);
+    double seconds;
+    t_job job = {func, option->M, option->N, A};
+    int threads;
+
+    printf("%s: %dx%d, best of %d\n", func->description, option->M,
+           option->N, option->r);
+    for (threads = 1; threads <= option->j;
+         threads = threads < option->j && threads * 2 > option->j
+                       ? option->j
+                       : threads * 2) {
+        job.threads = threads;
+        job.B = alloc_matrix(option->M, option->N);
+        seconds = measure(&job, option);
+        if (!check_transpose(&job))
+            errx(EXIT_FAILURE, "%s: wrong transpose with %d threads",
+                 func->description, threads);
+        printf("threads:%d seconds:%.3f GB/s:%.2f\n", threads, seconds,
+               bytes / seconds / 1e9);
+        free(job.B);
+    }
+}
+
+static bool check_transpose(const t_job *job) {
+    size_t i, j;
+
+    for (i = 0; i < (size_t)job->N; i++)
+        for (j = 0; j < (size_t)job->M; j++)
+            if (job->A[i * job->M + j] != job->B[j * job->N + i])
+                return false;
+    return true;
+}
+
+/*
+ * The calling thread takes share 0 of every run, and the pool lives only
+ * as long as this thread count.
+ */
+static double measure(t_job *job, const t_option *option) {
+    t_runner *runners = safe_calloc(job->threads, sizeof(t_runner));
+    struct timespec begin, end;
+    double seconds, best = 0;
+    int i, run;
+
+    job->quit = false;
+    pthread_barrier_init(&job->start, NULL, job->threads);
+    pthread_barrier_init(&job->finish, NULL, job->threads);
+    for (i = 1; i < job->threads; i++) {
+        runners[i].job = job;
+        runners[i].id = i;
+        if ((errno = pthread_create(&runners[i].thread, NULL, run_worker,
+                                    &runners[i])))
+            err(EXIT_FAILURE, "pthread_create");
+    }
+    for (run = 0; run <= option->r; run++) {
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        pthread_barrier_wait(&job->start);
+        run_share(job, 0);
+        pthread_barrier_wait(&job->finish);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        seconds = end.tv_sec - begin.tv_sec +
+                  (end.tv_nsec - begin.tv_nsec) / 1e9;
+        /* Run 0 only places the pages of B. */
+        if (run == 1 || (run > 1 && seconds < best))
+            best = seconds;
+    }
+    job->quit = true;
+    pthread_barrier_wait(&job->start);
+    for (i = 1; i < job->threads; i++)
+        pthread_join(runners[i].thread, NULL);
+    pthread_barrier_destroy(&job->start);
+    pthread_barrier_destroy(&job->finish);
+    safe_free((void **)&runners);
+    return best;
+}
+
+static void parse_arguments(int argc, char *const argv[], t_option *option) {
+    const char *program_name = argv[0];
+    int opt;
+
+    option->M = option->N = 16384;
+    option->j = sysconf(_SC_NPROCESSORS_ONLN);
+    option->r = 3;
+    while ((opt = getopt(argc, argv, "hM:N:j:r:")) != -1) {
+        switch (opt) {
+        case 'h':
+            print_usage_and_exit(program_name, EXIT_SUCCESS);
+        case 'M':
+            option->M = atoi(optarg);
+            break;
+        case 'N':
+            option->N = atoi(optarg);
+            break;
+        case 'j':
+            option->j = atoi(optarg);
+            break;
+        case 'r':
+            option->r = atoi(optarg);
+            break;
+        default:
+            print_usage_and_exit(program_name, EXIT_FAILURE);
+        }
+    }
+    if (option->M <= 0 || option->N <= 0 || option->j <= 0 || option->r <= 0) {
+        fprintf(stderr, "%s: Invalid command line argument\n", program_name);
+        print_usage_and_exit(program_name, EXIT_FAILURE);
+    }
+}
+
+static void print_usage_and_exit(const char *program_name, int exit_code) {
+    FILE *stream = exit_code == EXIT_SUCCESS ? stdout : stderr;
+
+    fprintf(stream, usage_format, program_name, program_name, program_name);
+    exit(exit_code);
+}
+
+static void run_share(t_job *job, int id) {
+    job->func->func_ptr(job->M, job->N, (void *)job->A, (void *)job->B, id,
+                        job->threads);
+}
+
+static void *run_worker(void *arg) {
+    t_runner *runner = arg;
+    t_job *job = runner->job;
+
+    for (;;) {
+        pthread_barrier_wait(&job->start);
+        if (job->quit)
+            break;
+        run_share(job, runner->id);
+        pthread_barrier_wait(&job->finish);
+    }
+    return NULL;
+}
@@ -0,0 +1,122 @@
+#include "parallel.h"
+
+#include <err.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#include "utils.h"
+
+static void merge_counts(t_pool *pool, t_count *count);
+static void push_record(t_ring *ring, const t_record *record);
+static void *run_worker(void *arg);
+static void wait_idle(t_pool *pool);
+
+/*
+ * Sets are independent, so each worker owns a contiguous range of them and
+ * sees the accesses to its range in trace order. Widening the tags is the
+ * only change that touches every set, so it waits for all workers to idle.
+ */
+void dispatch_record(t_pool *pool, const t_record *record) {
+    t_cache *cache = pool->cache;
+    uint64_t tag = record->address >> (cache->s + cache->b);
+    uint64_t set_index = (record->address >> cache->b) & (cache->S - 1);
+
+    if (cache->tag_size < sizeof(uint64_t) && tag > UINT32_MAX) {
+        wait_idle(pool);
+        widen_tags(cache);
+    }
+    push_record(&pool->workers[(set_index * pool->n) >> cache->s].ring,
+                record);
+}
+
+void init_pool(t_pool *pool, t_cache *cache, size_t n) {
+    size_t i;
+
+    if (n > cache->S)
+        n = cache->S;
+    pool->n = n;
+    pool->cache = cache;
+    pool->workers = (t_worker *)safe_calloc(n, sizeof(t_worker));
+    for (i = 0; i < n; ++i) {
+        pool->workers[i].cache = cache;
+        if (pthread_create(&pool->workers[i].thread, NULL, run_worker,
+                           &pool->workers[i]))
+            errx(EXIT_FAILURE, "pthread_create()");
+    }
+}
+
+void join_pool(t_pool *pool, t_count *count) {
+    size_t i;
+
+    for (i = 0; i < pool->n; ++i)
+        __atomic_store_n(&pool->workers[i].done, true, __ATOMIC_RELEASE);
+    for (i = 0; i < pool->n; ++i)
+        pthread_join(pool->workers[i].thread, NULL);
+    merge_counts(pool, count);
+    safe_free((void **)&pool->workers);
+}
+
+/* Waits until every dispatched record is simulated, then collects counts. */
+void sync_pool(t_pool *pool, t_count *count) {
+    wait_idle(pool);
+    merge_counts(pool, count);
+}
+
+static void merge_counts(t_pool *pool, t_count *count) {
+    t_count *worker_count;
+    size_t i;
+
+    for (i = 0; i < pool->n; ++i) {
+        worker_count = &pool->workers[i].count;
+        count->eviction += worker_count->eviction;
+        count->hit += worker_count->hit;
+        count->miss += worker_count->miss;
+        *worker_count = (t_count){0};
+    }
+}
+
+static void push_record(t_ring *ring, const t_record *record) {
+    size_t tail = ring->tail;
+
+    while (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == RING_SIZE)
+        sched_yield();
+    ring->records[tail % RING_SIZE] = *record;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void *run_worker(void *arg) {
+    t_worker *worker = arg;
+    t_ring *ring = &worker->ring;
+    size_t head = ring->head;
+    size_t tail;
+    t_record *record;
+    bool done;
+
+    for (;;) {
+        done = __atomic_load_n(&worker->done, __ATOMIC_ACQUIRE);
+        tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            if (done)
+                return NULL;
+            sched_yield();
+            continue;
+        }
+        for (; head != tail; ++head) {
+            record = &ring->records[head % RING_SIZE];
+            access_memory(record->address, worker->cache, &worker->count);
+            worker->count.hit += record->hits;
+        }
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    }
+}
+
+static void wait_idle(t_pool *pool) {
+    t_ring *ring;
+    size_t i;
+
+    for (i = 0; i < pool->n; ++i) {
+        ring = &pool->workers[i].ring;
+        while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) != ring->tail)
+            sched_yield();
+    }
+}
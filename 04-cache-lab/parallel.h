@@ -0,0 +1,43 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <pthread.h>
+
+#include "cache.h"
+#include "trace.h"
+
+#define RING_SIZE 4096
+
+/*
+ * Single-producer, single-consumer queue of records. The parser only
+ * writes `tail` and the worker only writes `head`; both grow without
+ * wrapping and are reduced modulo RING_SIZE to index `records`.
+ */
+typedef struct s_ring {
+    size_t head;
+    char head_padding[64 - sizeof(size_t)];
+    size_t tail;
+    char tail_padding[64 - sizeof(size_t)];
+    t_record records[RING_SIZE];
+} t_ring;
+
+typedef struct s_worker {
+    pthread_t thread;
+    t_cache *cache;
+    t_count count;
+    bool done;
+    t_ring ring;
+} t_worker;
+
+typedef struct s_pool {
+    size_t n;
+    t_cache *cache;
+    t_worker *workers;
+} t_pool;
+
+void dispatch_record(t_pool *pool, const t_record *record);
+void init_pool(t_pool *pool, t_cache *cache, size_t n);
+void join_pool(t_pool *pool, t_count *count);
+void sync_pool(t_pool *pool, t_count *count);
+
+#endif
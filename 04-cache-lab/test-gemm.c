@@ -0,0 +1,220 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <err.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "cachelab.h"
+#include "memtrace.h"
+#include "utils.h"
+
+/* Same bound as test-trans */
+#define MAXN 256
+
+typedef struct s_option {
+    int M, N, K;
+    int F;
+    size_t s, E, b;
+    bool B;
+} t_option;
+
+static const char *usage_format =
+    "Usage: %s [-hB] [-s <num> -E <num> -b <num>] [-F <num>]\n"
+    "          -M <rows> -N <cols> -K <depth>\n"
+    "Options:\n"
+    "  -h          Print this help message.\n"
+    "  -B          Also time the functions with bench-gemm.\n"
+    "  -s <num>    Number of set index bits (default: 5).\n"
+    "  -E <num>    Number of lines per set (default: 1).\n"
+    "  -b <num>    Number of block offset bits (default: 5).\n"
+    "  -F <num>    Only evaluate this registered function.\n"
+    "  -M <rows>   Rows of A and C (max %d).\n"
+    "  -N <cols>   Columns of B and C (max %d).\n"
+    "  -K <depth>  Columns of A and rows of B (max %d); with 0, C must\n"
+    "              come out all zeros.\n"
+    "\n"
+    "Examples:\n"
+    "  linux>  %s -M 32 -N 32 -K 32\n"
+    "  linux>  %s -B -s 6 -E 8 -b 6 -M 256 -N 256 -K 256\n";
+
+/* External function defined in gemm.c */
+extern void registerGemmFunctions();
+
+/* External variables defined in cachelab.c */
+extern gemm_func_t gemm_func_list[MAX_TRANS_FUNCS];
+extern int gemm_func_counter;
+
+/* Laid out like the matrices of test-trans, whole cache sizes apart */
+static double A[MAXN * MAXN];
+static double B[MAXN * MAXN];
+static double C[MAXN * MAXN];
+static double R[MAXN * MAXN];
+
+static bool evaluate(const t_option *option, int i);
+static void parse_arguments(int argc, char *const argv[], t_option *option);
+static void print_bench(const t_option *option);
+static void print_usage_and_exit(const char *program_name, int exit_code);
+
+int main(int argc, char *argv[]) {
+    t_option option = {0};
+    int i;
+
+    parse_arguments(argc, argv, &option);
+    registerGemmFunctions();
+    if (option.F >= gemm_func_counter) {
+        fprintf(stderr, "%s: No function %d\n", argv[0], option.F);
+        print_usage_and_exit(argv[0], EXIT_FAILURE);
+    }
+    for (i = 0; i < gemm_func_counter; i++) {
+        if (option.F >= 0 && i != option.F)
+            continue;
+        if (!evaluate(&option, i))
+            printf("func %d (%s): wrong product\n", i,
+                   gemm_func_list[i].description);
+    }
+    if (option.B)
+        print_bench(&option);
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Runs function i on the instrumented build of gemm.c and simulates its
+ * non-stack accesses, as test-trans does for the transposes.
+ */
+static bool evaluate(const t_option *option, int i) {
+    gemm_func_t *func = &gemm_func_list[i];
+    t_memtrace trace = {0};
+    t_count count = {0};
+    t_cache cache;
+    size_t j;
+    int M = option->M, N = option->N, K = option->K;
+
+    initGemm(M, N, K, (void *)A, (void *)B, (void *)C);
+    correctGemm(M, N, K, (void *)A, (void *)B, (void *)R);
+    start_memtrace(&trace);
+    func->func_ptr(M, N, K, (void *)A, (void *)B, (void *)C);
+    stop_memtrace();
+    if (memcmp(C, R, (size_t)M * N * sizeof(double))) {
+        free_memtrace(&trace);
+        return false;
+    }
+    init_cache(&cache, option->s, option->E, option->b);
+    for (j = 0; j < trace.length; j++) {
+        if (!is_stack_access(&trace, &trace.records[j]))
+            access_memory(trace.records[j].address, &cache, &count);
+    }
+    free_cache(&cache);
+    free_memtrace(&trace);
+    func->correct = 1;
+    func->num_hits = count.hit;
+    func->num_misses = count.miss;
+    func->num_evictions = count.eviction;
+    printf("func %d (%s): hits:%zu, misses:%zu, evictions:%zu\n", i,
+           func->description, count.hit, count.miss, count.eviction);
+    return true;
+}
+
+static void parse_arguments(int argc, char *const argv[], t_option *option) {
+    const char *program_name = argv[0];
+    int opt;
+
+    option->F = -1;
+    option->K = -1;
+    option->s = 5;
+    option->E = 1;
+    option->b = 5;
+    while ((opt = getopt(argc, argv, "hBs:E:b:F:M:N:K:")) != -1) {
+        switch (opt) {
+        case 'h':
+            print_usage_and_exit(program_name, EXIT_SUCCESS);
+        case 'B':
+            option->B = true;
+            break;
+        case 's':
+            option->s = atoi(optarg);
+            break;
+        case 'E':
+            option->E = atoi(optarg);
+            break;
+        case 'b':
+            option->b = atoi(optarg);
+            break;
+        case 'F':
+            option->F = atoi(optarg);
+            break;
+        case 'M':
+            option->M = atoi(optarg);
+            break;
+        case 'N':
+            option->N = atoi(optarg);
+            break;
+        case 'K':
+            option->K = atoi(optarg);
+            break;
+        default:
+            print_usage_and_exit(program_name, EXIT_FAILURE);
+        }
+    }
+    if (option->M <= 0 || option->N <= 0 || option->K < 0 ||
+        option->M > MAXN || option->N > MAXN || option->K > MAXN) {
+        fprintf(stderr, "%s: Missing or invalid matrix size\n", program_name);
+        print_usage_and_exit(program_name, EXIT_FAILURE);
+    }
+    if (option->B && option->K == 0) {
+        fprintf(stderr, "%s: Nothing to time with -K 0\n", program_name);
+        print_usage_and_exit(program_name, EXIT_FAILURE);
+    }
+    if (option->E <= 0 || option->s + option->b > 32) {
+        fprintf(stderr, "%s: Invalid cache geometry\n", program_name);
+        print_usage_and_exit(program_name, EXIT_FAILURE);
+    }
+}
+
+/*
+ * Times the functions with bench-gemm, which runs the optimized build,
+ * and tabulates the times next to the simulated misses.
+ */
+static void print_bench(const t_option *option) {
+    double ns[MAX_TRANS_FUNCS] = {0}, gflops[MAX_TRANS_FUNCS] = {0};
+    char cmd[255];
+    FILE *in;
+    double x, y;
+    int i;
+
+    sprintf(cmd,
+            "./bench-gemm -M %d -N %d -K %d -o .bench_results > /dev/null",
+            option->M, option->N, option->K);
+    if (system(cmd) != 0)
+        errx(EXIT_FAILURE, "./bench-gemm -M %d -N %d -K %d failed", option->M,
+             option->N, option->K);
+    in = safe_fopen(".bench_results", "r");
+    while (fscanf(in, "%d %lf %lf", &i, &x, &y) == 3) {
+        if (i >= 0 && i < MAX_TRANS_FUNCS) {
+            ns[i] = x;
+            gflops[i] = y;
+        }
+    }
+    fclose(in);
+
+    printf("\nWall clock (bench-gemm, optimized build)\n");
+    printf("func    misses   ns/fma   GFLOP/s\n");
+    for (i = 0; i < gemm_func_counter; i++) {
+        if (!gemm_func_list[i].correct)
+            continue;
+        printf("%4d  %8u  %7.3f  %8.2f  %s\n", i,
+               gemm_func_list[i].num_misses, ns[i], gflops[i],
+               gemm_func_list[i].description);
+    }
+}
+
+static void print_usage_and_exit(const char *program_name, int exit_code) {
+    FILE *stream = exit_code == EXIT_SUCCESS ? stdout : stderr;
+
+    fprintf(stream, usage_format, program_name, MAXN, MAXN, MAXN,
+            program_name, program_name);
+    exit(exit_code);
+}
@@ -3,6 +3,8 @@
  *     student's transpose functions and records the results for their
  *     official submitted version as well.
  */
+#define _DEFAULT_SOURCE /* for popen and MAP_ANONYMOUS */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -11,9 +13,13 @@
 #include <signal.h>
 #include <getopt.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include "cachelab.h"
+#include "cache.h"
+#include "memtrace.h"
 #include <sys/wait.h> // fir WEXITSTATUS
 #include <limits.h> // for INT_MAX
+#include <math.h>
 
 /* Maximum array dimension */
 #define MAXN 256
@@ -29,9 +35,78 @@ extern void registerFunctions();
 extern trans_func_t func_list[MAX_TRANS_FUNCS];
 extern int func_counter; 
 
+/* Markers that bound the traced region, as in tracegen */
+volatile char MARKER_START, MARKER_END;
+
+/* Matrices for in-process evaluation. They are declared like A and B
+   in tracegen, next to the markers and command line globals, so that
+   both tracers see the same cache conflicts. */
+static int A[MAXN][MAXN];
+static int B[MAXN][MAXN];
+
 /* Globals set on the command line */
 static int M = 0;
 static int N = 0;
+static int use_valgrind = 0;
+static int use_optimized = 0;
+static int use_sweep = 0;
+static int use_bench = 0;
+static int attribute_func = -1;
+static int attribution_fd = -1; /* written by the child evaluating it */
+static int element_size = 0;
+static int jobs = 1;
+
+/* Matrices of the typed functions, evaluated with -T */
+static long long TA[MAXN * MAXN * MAX_ELEMENT_SIZE / sizeof(long long)];
+static long long TB[MAXN * MAXN * MAX_ELEMENT_SIZE / sizeof(long long)];
+
+/* Cache geometries scored by -G. The first is the one set by -s, -E and
+   -b (the graded 1KB direct-mapped cache by default), the others are
+   presets modelled on the caches of common CPUs. */
+struct geometry {
+    unsigned int s, E, b;
+    const char *description;
+};
+static struct geometry geometries[] = {
+    {5, 1, 5, "selected with -s, -E and -b"},
+    {8, 2, 6, "32KB 2-way, 64B lines: L1d of Cortex-A72"},
+    {6, 8, 6, "32KB 8-way, 64B lines: L1d of Skylake and Zen"},
+    {6, 12, 6, "48KB 12-way, 64B lines: L1d of Ice Lake and later"},
+    {7, 8, 7, "128KB 8-way, 128B lines: L1d of Apple M1"},
+    {10, 4, 6, "256KB 4-way, 64B lines: L2 of Skylake client"},
+    {9, 8, 6, "256KB 8-way, 64B lines: L2 of Neoverse N1"},
+    {10, 8, 6, "512KB 8-way, 64B lines: L2 of Zen 2 and Zen 3"},
+    {10, 16, 6, "1MB 16-way, 64B lines: L2 of Skylake-SP"},
+};
+#define GEOMETRIES (int)(sizeof(geometries) / sizeof(geometries[0]))
+
+/* Where the accesses attributed by -A land */
+enum { REGION_A, REGION_B, REGION_OTHER, REGION_STACK, REGIONS };
+static const char *region_names[REGIONS] = {"A", "B", "other", "stack"};
+#define TILE_SIZE 8
+#define MAX_TILES (MAXN / TILE_SIZE)
+#define CONFLICTS_SHOWN 16
+
+/* A line evicting another one, and how often it did */
+struct conflict {
+    uint64_t evictor, victim;
+    unsigned int count;
+};
+
+/* The outcome of evaluating one function. Each function is evaluated in
+   a child process of its own, so these live in memory shared with it. */
+struct evaluation {
+    int ok;
+    unsigned int hits, misses, evictions;
+    unsigned int sweep_misses[GEOMETRIES];
+    char error[512];
+};
+static struct evaluation *evaluations;
+
+/* The children evaluating functions, by function, until reaped. Each
+   leads its own process group, so that killing the group also ends any
+   tracegen or valgrind it started. */
+static pid_t children[MAX_TRANS_FUNCS];
 
 /* The correctness and performance for the submitted transpose function */
 struct results {
@@ -41,120 +116,725 @@ struct results {
 };
 static struct results results = {-1, 0, INT_MAX};
 
-/* 
- * eval_perf - Evaluate the performance of the registered transpose functions
+/*
+ * validate - Check B against the baseline transpose of A
  */
-void eval_perf(unsigned int s, unsigned int E, unsigned int b)
+static int validate(int fn, int M, int N, int A[N][M], int B[M][N],
+                    char *error, size_t size)
+{
+    int i, j;
+
+    for (i = 0; i < N; i++) {
+        for (j = 0; j < M; j++) {
+            if (A[i][j] != B[j][i]) {
+                snprintf(error, size, "Validation failed on function %d! Expected %d but got %d at B[%d][%d]\n",
+                         fn, A[i][j], B[j][i], j, i);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static void simulate_memtrace(const t_memtrace *trace, int geometry_count,
+                              t_count *counts);
+
+/*
+ * validate_typed - Check TB against the transpose of TA, element by
+ *     element of element_size bytes
+ */
+static int validate_typed(int fn, char *error, size_t size)
+{
+    char *a = (char *)TA, *b = (char *)TB;
+    int i, j;
+
+    for (i = 0; i < N; i++) {
+        for (j = 0; j < M; j++) {
+            if (memcmp(a + ((size_t)i * M + j) * element_size,
+                       b + ((size_t)j * N + i) * element_size,
+                       element_size)) {
+                snprintf(error, size,
+                         "Validation failed on function %d at B[%d][%d]\n",
+                         fn, j, i);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+ * init_typed - Fill the typed matrices with random bytes
+ */
+static void init_typed(void)
+{
+    size_t k;
+
+    for (k = 0; k < (size_t)M * N * element_size; k++) {
+        ((char *)TA)[k] = rand();
+        ((char *)TB)[k] = rand();
+    }
+}
+
+/*
+ * trace_external - Generate the trace of function i with tracegen under
+ *     valgrind, or with tracegen-opt, and simulate it with the reference
+ *     simulator
+ */
+static int trace_external(int i, unsigned int s, unsigned int E, unsigned int b,
+                          struct evaluation *ev)
 {
-    int i,flag;
-    unsigned int len, hits, misses, evictions;
+    int flag;
+    unsigned int len;
     unsigned long long int marker_start, marker_end, addr;
     char buf[1000], cmd[255];
-    char filename[128];
-
-    registerFunctions(); 
+    char filename[128], full_filename[32], marker_filename[32];
 
     /* Open the complete trace file */
     FILE* full_trace_fp;  
     FILE* part_trace_fp; 
 
-    /* Evaluate the performance of each registered transpose function */
+    /* Use valgrind or tracegen-opt to generate the trace. Every function
+       has its own file names, so that several can be traced at once. */
+    sprintf(full_filename, "trace.tmp.f%d", i);
+    sprintf(marker_filename, ".marker.f%d", i);
+    sprintf(cmd, "%s -M %d -N %d -F %d -T %d -m %s > %s",
+            use_optimized ? "./tracegen-opt" : "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v ./tracegen",
+            M, N, i, element_size, marker_filename, full_filename);
+    flag=WEXITSTATUS(system(cmd));
+    if (0!=flag) {
+        snprintf(ev->error, sizeof(ev->error), "Validation error at function %d! Run ./tracegen -M %d -N %d -F %d for details.\nSkipping performance evaluation for this function.\n",flag-1,M,N,i);      
+        return 0;
+    }
 
-    for (i=0; i<func_counter; i++) {
-        if (strcmp(func_list[i].description, SUBMIT_DESCRIPTION) == 0 )
-            results.funcid = i; /* remember which function is the submission */
+    /* Get the start and end marker addresses */
+    FILE* marker_fp = fopen(marker_filename, "r");
+    assert(marker_fp);
+    fscanf(marker_fp, "%llx %llx", &marker_start, &marker_end);
+    fclose(marker_fp);
+
+    full_trace_fp = fopen(full_filename, "r");
+    assert(full_trace_fp);
+    /* Filtered trace for each transpose function goes in a separate file */
+    sprintf(filename, "trace.f%d", i);
+    part_trace_fp = fopen(filename, "w");
+    assert(part_trace_fp);
+    
+    /* Locate trace corresponding to the trans function */
+    flag = 0;
+    while (fgets(buf, 1000, full_trace_fp) != NULL) {
+
+        /* We are only interested in memory access instructions */
+        if (buf[0]==' ' && buf[2]==' ' &&
+            (buf[1]=='S' || buf[1]=='M' || buf[1]=='L' )) {
+            sscanf(buf+3, "%llx,%u", &addr, &len);
+        
+            /* If start marker found, set flag */
+            if (addr == marker_start)
+                flag = 1;
+
+            /* Valgrind creates many spurious accesses to the
+               stack that have nothing to do with the students
+               code. At the moment, we are ignoring all stack
+               accesses by using the simple filter of recording
+               accesses to only the low 32-bit portion of the
+               address space. At some point it would be nice to
+               try to do more informed filtering so that would
+               eliminate the valgrind stack references while
+               include the student stack references. */
+            if (flag && addr < 0xffffffff) {
+                fputs(buf, part_trace_fp);
+            }
+
+            /* if end marker found, close trace file */
+            if (addr == marker_end) {
+                flag = 0;
+                fclose(part_trace_fp);
+                break;
+            }
+        }
+    }
+    fclose(full_trace_fp);
 
+    /* Run the reference simulator, reading its summary line rather than
+       .csim_results, which every run writes */
+    sprintf(cmd, "./csim-ref -s %u -E %u -b %u -t trace.f%d", s, E, b, i);
+    FILE* in_fp = popen(cmd, "r");
+    assert(in_fp);
+    while (fgets(buf, 1000, in_fp) != NULL)
+        sscanf(buf, "hits:%u misses:%u evictions:%u",
+               &ev->hits, &ev->misses, &ev->evictions);
+    pclose(in_fp);
+    return 1;
+}
 
-        printf("\nFunction %d (%d total)\nStep 1: Validating and generating memory traces\n",i,func_counter);
-        /* Use valgrind to generate the trace */
+/*
+ * locate_line - Find which array the line of line_size bytes at address
+ *     overlaps, and the row and column of its first element in it.
+ *     Returns REGION_OTHER when it overlaps neither.
+ */
+static int locate_line(uint64_t address, size_t line_size, int *row, int *col)
+{
+    int size = element_size ? element_size : sizeof(int);
+    int region, cols;
+    uint64_t base, end, first;
 
-        sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v ./tracegen -M %d -N %d -F %d  > trace.tmp", M, N,i);
-        flag=WEXITSTATUS(system(cmd));
-        if (0!=flag) {
-            printf("Validation error at function %d! Run ./tracegen -M %d -N %d -F %d for details.\nSkipping performance evaluation for this function.\n",flag-1,M,N,i);      
+    for (region = REGION_A; region <= REGION_B; region++) {
+        if (element_size)
+            base = (uintptr_t)(region == REGION_A ? TA : TB);
+        else
+            base = (uintptr_t)(region == REGION_A ? &A[0][0] : &B[0][0]);
+        end = base + (uint64_t)M * N * size;
+        if (address + line_size <= base || address >= end)
             continue;
+        first = address < base ? 0 : (address - base + size - 1) / size;
+        cols = region == REGION_A ? M : N;
+        *row = first / cols;
+        *col = first % cols;
+        return region;
+    }
+    return REGION_OTHER;
+}
+
+/*
+ * compare_conflicts - Order conflicts by line pair, or by falling count
+ *     once counted
+ */
+static int compare_conflicts(const void *x, const void *y)
+{
+    const struct conflict *a = x, *b = y;
+
+    if (a->evictor != b->evictor)
+        return a->evictor < b->evictor ? -1 : 1;
+    if (a->victim != b->victim)
+        return a->victim < b->victim ? -1 : 1;
+    return 0;
+}
+
+static int compare_counts(const void *x, const void *y)
+{
+    const struct conflict *a = x, *b = y;
+
+    if (a->count != b->count)
+        return a->count > b->count ? -1 : 1;
+    return compare_conflicts(x, y);
+}
+
+/*
+ * name_line - Name the array element a line starts at, or its address
+ *     when it is in neither array
+ */
+static void name_line(uint64_t address, size_t line_size, char *name,
+                      size_t size)
+{
+    int region, row, col;
+
+    region = locate_line(address, line_size, &row, &col);
+    if (region == REGION_OTHER)
+        snprintf(name, size, "%#llx", (unsigned long long)address);
+    else
+        snprintf(name, size, "%s[%d][%d]", region_names[region], row, col);
+}
+
+/*
+ * print_tiles - Print a grid of per-tile counts of an array of the
+ *     given shape
+ */
+static void print_tiles(FILE *out, const char *what, int region, int rows,
+                        int cols, unsigned int tiles[MAX_TILES][MAX_TILES])
+{
+    int r, c;
+
+    fprintf(out, "\n%s per %dx%d tile of %s (%dx%d)\n    ", what, TILE_SIZE,
+           TILE_SIZE, region_names[region], rows, cols);
+    for (c = 0; c < (cols + TILE_SIZE - 1) / TILE_SIZE; c++)
+        fprintf(out, " %5d", c * TILE_SIZE);
+    fprintf(out, "\n");
+    for (r = 0; r < (rows + TILE_SIZE - 1) / TILE_SIZE; r++) {
+        fprintf(out, "%4d", r * TILE_SIZE);
+        for (c = 0; c < (cols + TILE_SIZE - 1) / TILE_SIZE; c++)
+            fprintf(out, " %5u", tiles[r][c]);
+        fprintf(out, "\n");
+    }
+}
+
+/*
+ * attribute_misses - Break the hits and misses of function i's trace on
+ *     the selected cache down by array and by tile, and list the lines
+ *     that evict each other most often
+ */
+static void attribute_misses(int i, const t_memtrace *trace, FILE *out)
+{
+    static unsigned int tile_hits[2][MAX_TILES][MAX_TILES];
+    static unsigned int tile_misses[2][MAX_TILES][MAX_TILES];
+    t_count counts[REGIONS] = {{0}};
+    unsigned int evictions[REGIONS][REGIONS] = {{0}};
+    struct conflict *conflicts = NULL;
+    size_t conflict_count = 0, capacity = 0, line_size, j, k;
+    t_cache cache;
+    const t_record *record;
+    uint64_t victim;
+    unsigned int stack_accesses = 0;
+    char evictor[32], name[32];
+    int region, victim_region, row, col, r, c;
+    size_t misses;
+
+    line_size = (size_t)1 << geometries[0].b;
+    init_cache(&cache, geometries[0].s, geometries[0].E, geometries[0].b);
+    for (j = 0; j < trace->length; j++) {
+        record = &trace->records[j];
+        if (is_stack_access(trace, record)) {
+            stack_accesses++;
+            continue;
+        }
+        region = locate_line(record->address, 1, &row, &col);
+        victim = find_victim(&cache, record->address);
+        misses = counts[region].miss;
+        access_memory(record->address, &cache, &counts[region]);
+        if (region != REGION_OTHER) {
+            if (counts[region].miss != misses)
+                tile_misses[region][row / TILE_SIZE][col / TILE_SIZE]++;
+            else
+                tile_hits[region][row / TILE_SIZE][col / TILE_SIZE]++;
         }
+        if (victim == UINT64_MAX)
+            continue;
+        victim_region = locate_line(victim, line_size, &r, &c);
+        evictions[region][victim_region]++;
+        if (conflict_count == capacity) {
+            capacity = capacity ? 2 * capacity : 1024;
+            conflicts = realloc(conflicts, capacity * sizeof(*conflicts));
+            assert(conflicts);
+        }
+        conflicts[conflict_count].evictor =
+            record->address & ~(uint64_t)(line_size - 1);
+        conflicts[conflict_count].victim = victim;
+        conflicts[conflict_count].count = 1;
+        conflict_count++;
+    }
+    free_cache(&cache);
 
-        /* Get the start and end marker addresses */
-        FILE* marker_fp = fopen(".marker", "r");
-        assert(marker_fp);
-        fscanf(marker_fp, "%llx %llx", &marker_start, &marker_end);
-        fclose(marker_fp);
+    fprintf(out, "\nMiss attribution for function %d (%s), s=%u, E=%u, b=%u\n", i,
+           func_list[i].description, geometries[0].s, geometries[0].E,
+           geometries[0].b);
+    fprintf(out, "region      hits    misses\n");
+    for (region = REGION_A; region < REGION_STACK; region++)
+        fprintf(out, "%-6s  %8zu  %8zu\n", region_names[region],
+               counts[region].hit, counts[region].miss);
+    fprintf(out, "%-6s  %u accesses, not simulated\n", region_names[REGION_STACK],
+           stack_accesses);
 
+    for (region = REGION_A; region <= REGION_B; region++) {
+        r = region == REGION_A ? N : M;
+        c = region == REGION_A ? M : N;
+        print_tiles(out, "Misses", region, r, c, tile_misses[region]);
+        print_tiles(out, "Hits", region, r, c, tile_hits[region]);
+    }
 
-        func_list[i].correct=1;
+    fprintf(out, "\nEvictions (rows evict columns)\n      ");
+    for (victim_region = REGION_A; victim_region < REGION_STACK;
+         victim_region++)
+        fprintf(out, "  %8s", region_names[victim_region]);
+    fprintf(out, "\n");
+    for (region = REGION_A; region < REGION_STACK; region++) {
+        fprintf(out, "%-6s", region_names[region]);
+        for (victim_region = REGION_A; victim_region < REGION_STACK;
+             victim_region++)
+            fprintf(out, "  %8u", evictions[region][victim_region]);
+        fprintf(out, "\n");
+    }
 
-        /* Save the correctness of the transpose submission */
-        if (results.funcid == i ) {
-            results.correct = 1;
+    /* Count each pair of lines once, then show the most frequent */
+    if (conflict_count > 0) {
+        qsort(conflicts, conflict_count, sizeof(*conflicts),
+              compare_conflicts);
+        for (j = 0, k = 1; k < conflict_count; k++) {
+            if (!compare_conflicts(&conflicts[j], &conflicts[k]))
+                conflicts[j].count++;
+            else
+                conflicts[++j] = conflicts[k];
         }
+        conflict_count = j + 1;
+        qsort(conflicts, conflict_count, sizeof(*conflicts), compare_counts);
+    }
+    fprintf(out, "\nMost frequent conflicts (the line starting at the evictor "
+           "evicts the victim's)\ncount  evictor           victim\n");
+    for (j = 0; j < conflict_count && j < CONFLICTS_SHOWN; j++) {
+        name_line(conflicts[j].evictor, line_size, evictor, sizeof(evictor));
+        name_line(conflicts[j].victim, line_size, name, sizeof(name));
+        fprintf(out, "%5u  %-16s  %s\n", conflicts[j].count, evictor, name);
+    }
+    free(conflicts);
+}
 
-        full_trace_fp = fopen("trace.tmp", "r");
-        assert(full_trace_fp);
+/*
+ * record_function - Run function i on fresh matrices, recording its
+ *     loads and stores in trace
+ */
+static void record_function(int i, t_memtrace *trace)
+{
+    initMatrix(M, N, A, B);
+    init_typed();
+    /* The valgrind traces also hold the marker stores and the loads
+       tracegen makes to call the function, so record those as well */
+    prepareTransFunction(i, M, N, A, B);
+    start_memtrace(trace);
+    record_access('S', &MARKER_START, 1);
+    record_access('L', &func_list[i].typed_ptr, 8);
+    if (func_list[i].typed_ptr) {
+        record_access('L', &func_list[i].typed_ptr, 8);
+        record_access('L', &M, 4);
+        record_access('L', &N, 4);
+        (*func_list[i].typed_ptr)(M, N, TA, TB);
+    } else {
+        record_access('L', &func_list[i].inplace_ptr, 8);
+        if (func_list[i].inplace_ptr) {
+            record_access('L', &func_list[i].inplace_ptr, 8);
+            record_access('L', &M, 4);
+            record_access('L', &N, 4);
+            (*func_list[i].inplace_ptr)(M, N, &B[0][0]);
+        } else {
+            record_access('L', &func_list[i].func_ptr, 8);
+            record_access('L', &M, 4);
+            record_access('L', &N, 4);
+            (*func_list[i].func_ptr)(M, N, A, B);
+        }
+    }
+    record_access('S', &MARKER_END, 1);
+    stop_memtrace();
+}
 
+/*
+ * trace_inprocess - Run function i on the instrumented build of
+ *     trans.c, recording its loads and stores in memory, and simulate
+ *     them on the in-process cache model. Stack accesses are ignored,
+ *     as they are in the valgrind traces.
+ */
+static int trace_inprocess(int i, struct evaluation *ev)
+{
+    t_memtrace trace = {0};
+    t_count counts[GEOMETRIES];
+    FILE *out;
+    size_t len;
+    int g, ok;
 
-        /* Filtered trace for each transpose function goes in a separate file */
-        sprintf(filename, "trace.f%d", i);
-        part_trace_fp = fopen(filename, "w");
-        assert(part_trace_fp);
-    
-        /* Locate trace corresponding to the trans function */
-        flag = 0;
-        while (fgets(buf, 1000, full_trace_fp) != NULL) {
-
-            /* We are only interested in memory access instructions */
-            if (buf[0]==' ' && buf[2]==' ' &&
-                (buf[1]=='S' || buf[1]=='M' || buf[1]=='L' )) {
-                sscanf(buf+3, "%llx,%u", &addr, &len);
-        
-                /* If start marker found, set flag */
-                if (addr == marker_start)
-                    flag = 1;
-
-                /* Valgrind creates many spurious accesses to the
-                   stack that have nothing to do with the students
-                   code. At the moment, we are ignoring all stack
-                   accesses by using the simple filter of recording
-                   accesses to only the low 32-bit portion of the
-                   address space. At some point it would be nice to
-                   try to do more informed filtering so that would
-                   eliminate the valgrind stack references while
-                   include the student stack references. */
-                if (flag && addr < 0xffffffff) {
-                    fputs(buf, part_trace_fp);
-                }
-
-                /* if end marker found, close trace file */
-                if (addr == marker_end) {
-                    flag = 0;
-                    fclose(part_trace_fp);
-                    break;
-                }
+    record_function(i, &trace);
+    if (element_size)
+        ok = validate_typed(i, ev->error, sizeof(ev->error));
+    else
+        ok = validate(i, M, N, A, B, ev->error, sizeof(ev->error));
+    if (!ok) {
+        len = strlen(ev->error);
+        snprintf(ev->error + len, sizeof(ev->error) - len,
+                 "Validation error at function %d!\nSkipping performance evaluation for this function.\n", i);
+        free_memtrace(&trace);
+        return 0;
+    }
+
+    simulate_memtrace(&trace, use_sweep ? GEOMETRIES : 1, counts);
+    ev->hits = counts[0].hit;
+    ev->misses = counts[0].miss;
+    ev->evictions = counts[0].eviction;
+    for (g = 0; use_sweep && g < GEOMETRIES; g++)
+        ev->sweep_misses[g] = counts[g].miss;
+    if (i == attribute_func) {
+        out = fdopen(attribution_fd, "w");
+        assert(out);
+        attribute_misses(i, &trace, out);
+        fclose(out);
+    }
+    free_memtrace(&trace);
+    return 1;
+}
+
+/*
+ * simulate_memtrace - Count the hits, misses and evictions of the
+ *     non-stack accesses of a trace on fresh caches of the first
+ *     geometry_count geometries, all in one pass over the trace
+ */
+static void simulate_memtrace(const t_memtrace *trace, int geometry_count,
+                              t_count *counts)
+{
+    t_cache caches[GEOMETRIES];
+    size_t j;
+    int g;
+
+    memset(counts, 0, geometry_count * sizeof(*counts));
+    for (g = 0; g < geometry_count; g++)
+        init_cache(&caches[g], geometries[g].s, geometries[g].E,
+                   geometries[g].b);
+    for (j = 0; j < trace->length; j++) {
+        if (is_stack_access(trace, &trace->records[j]))
+            continue;
+        for (g = 0; g < geometry_count; g++)
+            access_memory(trace->records[j].address, &caches[g], &counts[g]);
+    }
+    for (g = 0; g < geometry_count; g++)
+        free_cache(&caches[g]);
+}
+
+/*
+ * print_bench - Time every function with bench-trans, which runs an
+ *     optimized build of trans.c, and list the results next to the
+ *     simulated misses
+ */
+static void print_bench(void)
+{
+    char cmd[255];
+    double ns[MAX_TRANS_FUNCS] = {0}, gbps[MAX_TRANS_FUNCS] = {0};
+    double elem_ns, elem_gbps;
+    int i;
+
+    sprintf(cmd, "./bench-trans -M %d -N %d -o .bench_results > /dev/null",
+            M, N);
+    if (WEXITSTATUS(system(cmd)) != 0) {
+        printf("\nError: ./bench-trans -M %d -N %d failed\n", M, N);
+        return;
+    }
+    FILE* in_fp = fopen(".bench_results", "r");
+    assert(in_fp);
+    while (fscanf(in_fp, "%d %lf %lf", &i, &elem_ns, &elem_gbps) == 3) {
+        if (i >= 0 && i < MAX_TRANS_FUNCS) {
+            ns[i] = elem_ns;
+            gbps[i] = elem_gbps;
+        }
+    }
+    fclose(in_fp);
+
+    printf("\nWall clock (bench-trans, optimized build)\n");
+    printf("func    misses   ns/elem      GB/s\n");
+    for (i = 0; i < func_counter; i++) {
+        if (!func_list[i].correct)
+            continue;
+        printf("%4d  %8u  %8.3f  %8.2f  %s\n", i, func_list[i].num_misses,
+               ns[i], gbps[i], func_list[i].description);
+    }
+}
+
+/*
+ * print_sweep - Tabulate the misses of every correct function on each
+ *     geometry. A function's score is the geometric mean, over the
+ *     geometries, of its misses relative to the fewest any function of
+ *     its kind had there: 1.00 is the best on every cache. In-place
+ *     functions touch one matrix instead of two, so they are ranked
+ *     among themselves, after the out-of-place ones.
+ */
+static void print_sweep(void)
+{
+    int i, g, kind, headed = 0;
+    unsigned int best[2][GEOMETRIES];
+    char label[32];
+    double score;
+
+    for (kind = 0; kind < 2; kind++)
+        for (g = 0; g < GEOMETRIES; g++)
+            best[kind][g] = UINT_MAX;
+    for (i = 0; i < func_counter; i++) {
+        if (!func_list[i].correct)
+            continue;
+        kind = func_list[i].inplace_ptr != NULL;
+        for (g = 0; g < GEOMETRIES; g++)
+            if (evaluations[i].sweep_misses[g] < best[kind][g])
+                best[kind][g] = evaluations[i].sweep_misses[g];
+    }
+
+    printf("\nCache geometries (s:E:b)\n");
+    for (g = 0; g < GEOMETRIES; g++) {
+        snprintf(label, sizeof(label), "%u:%u:%u", geometries[g].s,
+                 geometries[g].E, geometries[g].b);
+        printf("%10s  %s\n", label, geometries[g].description);
+    }
+    printf("\nMisses per cache geometry\nfunc");
+    for (g = 0; g < GEOMETRIES; g++) {
+        snprintf(label, sizeof(label), "%u:%u:%u", geometries[g].s,
+                 geometries[g].E, geometries[g].b);
+        printf("  %8s", label);
+    }
+    printf("  score\n");
+    for (kind = 0; kind < 2; kind++) {
+        for (i = 0; i < func_counter; i++) {
+            if (!func_list[i].correct ||
+                (func_list[i].inplace_ptr != NULL) != kind)
+                continue;
+            if (kind && !headed) {
+                printf("in-place, scored among themselves:\n");
+                headed = 1;
             }
+            printf("%4d", i);
+            score = 0;
+            for (g = 0; g < GEOMETRIES; g++) {
+                printf("  %8u", evaluations[i].sweep_misses[g]);
+                score += log((evaluations[i].sweep_misses[g] + 1.0) /
+                             (best[kind][g] + 1.0));
+            }
+            printf("  %5.2f  %s\n", exp(score / GEOMETRIES),
+                   func_list[i].description);
         }
-        fclose(full_trace_fp);
+    }
+}
+
+/*
+ * print_attribution - Copy out the report of -A, which the child that
+ *     evaluated the function wrote
+ */
+static void print_attribution(void)
+{
+    char buf[1000];
+    ssize_t n;
+
+    if (attribute_func >= func_counter ||
+        func_list[attribute_func].size != element_size ||
+        !func_list[attribute_func].correct) {
+        printf("\nError: No correct function %d to attribute misses of\n",
+               attribute_func);
+        return;
+    }
+    fflush(stdout);
+    lseek(attribution_fd, 0, SEEK_SET);
+    while ((n = read(attribution_fd, buf, sizeof(buf))) > 0)
+        fwrite(buf, 1, n, stdout);
+}
+
+/*
+ * evaluate - Validate, trace and simulate function i in a child process,
+ *     which keeps the outcome in evaluations[i], and return its pid.
+ *     Every child starts from the same state, so the addresses it sees
+ *     do not depend on which functions ran before it or alongside it.
+ */
+static pid_t evaluate(int i, unsigned int s, unsigned int E, unsigned int b)
+{
+    struct evaluation *ev = &evaluations[i];
+    pid_t pid;
+
+    fflush(stdout);
+    if ((pid = fork()) < 0) {
+        fprintf(stderr, "Unable to fork\n");
+        exit(1);
+    }
+    /* Set by both, so the group exists before the parent can kill it */
+    setpgid(pid, pid);
+    if (pid > 0)
+        return pid;
+    /* A crash must only end this child: the parent reports it, and only
+       the parent prints the results line or kills the children */
+    signal(SIGSEGV, SIG_DFL);
+    signal(SIGBUS, SIG_DFL);
+    signal(SIGALRM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    if (use_valgrind || use_optimized)
+        ev->ok = trace_external(i, s, E, b, ev);
+    else
+        ev->ok = trace_inprocess(i, ev);
+    exit(0);
+}
+
+/*
+ * reap - Wait for one of the children evaluating functions, and record
+ *     in its evaluation if it was killed by a signal
+ */
+static void reap(pid_t pids[])
+{
+    struct evaluation *ev;
+    pid_t pid;
+    int i, status;
+
+    if ((pid = wait(&status)) < 0)
+        return;
+    for (i = 0; i < func_counter && pids[i] != pid; i++)
+        ;
+    if (i == func_counter)
+        return;
+    pids[i] = 0;
+    if (!WIFSIGNALED(status))
+        return;
+    ev = &evaluations[i];
+    ev->ok = 0;
+    snprintf(ev->error, sizeof(ev->error),
+             "Function %d crashed (%s)!\nSkipping performance evaluation for this function.\n",
+             i, strsignal(WTERMSIG(status)));
+}
+
+/* 
+ * eval_perf - Evaluate the performance of the registered transpose functions
+ */
+void eval_perf(unsigned int s, unsigned int E, unsigned int b)
+{
+    char attribution_name[] = "attribution.tmp.XXXXXX";
+    pid_t *pids = children;
+    int i, running = 0, total = 0;
+    struct evaluation *ev;
+
+    registerFunctions(); 
 
-        /* Run the reference simulator */
+    geometries[0].s = s;
+    geometries[0].E = E;
+    geometries[0].b = b;
+    evaluations = mmap(NULL, MAX_TRANS_FUNCS * sizeof(*evaluations),
+                       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                       -1, 0);
+    assert(evaluations != MAP_FAILED);
+    /* A bare file descriptor, as a FILE would be allocated on the heap
+       that the functions' scratch space comes from */
+    if (attribute_func >= 0) {
+        attribution_fd = mkstemp(attribution_name);
+        assert(attribution_fd >= 0);
+        unlink(attribution_name);
+    }
+
+    /* Keep up to jobs children evaluating functions at a time */
+    for (i=0; i<func_counter; i++) {
+        /* Only the functions on elements of the selected size */
+        if (func_list[i].size != element_size)
+            continue;
+        total++;
+        if (running == jobs) {
+            reap(pids);
+            running--;
+        }
+        pids[i] = evaluate(i, s, E, b);
+        running++;
+    }
+    while (running > 0) {
+        reap(pids);
+        running--;
+    }
+
+    /* Report the outcomes in registration order */
+
+    for (i=0; i<func_counter; i++) {
+        if (func_list[i].size != element_size)
+            continue;
+        if (strcmp(func_list[i].description, SUBMIT_DESCRIPTION) == 0 )
+            results.funcid = i; /* remember which function is the submission */
+
+        ev = &evaluations[i];
+        printf("\nFunction %d (%d total)\nStep 1: Validating and generating memory traces\n",i,total);
+        if (!ev->ok) {
+            if (ev->error[0] == '\0')
+                printf("Function %d did not finish!\nSkipping performance evaluation for this function.\n", i);
+            printf("%s", ev->error);
+            continue;
+        }
         printf("Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n", s, E, b);
-        char cmd[255];
-        sprintf(cmd, "./csim-ref -s %u -E %u -b %u -t trace.f%d > /dev/null", 
-                s, E, b, i);
-        system(cmd);
-    
-        /* Collect results from the reference simulator */
-        FILE* in_fp = fopen(".csim_results","r");
-        assert(in_fp);
-        fscanf(in_fp, "%u %u %u", &hits, &misses, &evictions);
-        fclose(in_fp);
-        func_list[i].num_hits = hits;
-        func_list[i].num_misses = misses;
-        func_list[i].num_evictions = evictions;
+
+        func_list[i].correct=1;
+
+        /* Save the correctness of the transpose submission */
+        if (results.funcid == i ) {
+            results.correct = 1;
+        }
+
+        func_list[i].num_hits = ev->hits;
+        func_list[i].num_misses = ev->misses;
+        func_list[i].num_evictions = ev->evictions;
         printf("func %u (%s): hits:%u, misses:%u, evictions:%u\n",
-               i, func_list[i].description, hits, misses, evictions);
+               i, func_list[i].description, ev->hits, ev->misses,
+               ev->evictions);
     
         /* If it is transpose_submit(), record number of misses */
         if (results.funcid == i) {
-            results.misses = misses;
+            results.misses = ev->misses;
         }
     }
   
@@ -164,14 +844,41 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
  * usage - Print usage info
  */
 void usage(char *argv[]){
-    printf("Usage: %s [-h] -M <rows> -N <cols>\n", argv[0]);
+    printf("Usage: %s [-hBGOV] [-j <num>] [-A <func>] [-T <bytes>]\n"
+           "       [-s <num> -E <num> -b <num>] -M <rows> -N <cols>\n", argv[0]);
     printf("Options:\n");
     printf("  -h          Print this help message.\n");
+    printf("  -B          Also time the functions with bench-trans.\n");
+    printf("  -G          Also score the functions on preset L1 and L2 geometries.\n");
+    printf("  -O          Trace the optimized build with tracegen-opt and simulate\n"
+           "              with csim-ref.\n");
+    printf("  -V          Trace with valgrind and simulate with csim-ref.\n");
+    printf("  -j <num>    Evaluate this many functions at a time (default 1).\n");
+    printf("  -A <func>   Break the misses of a function down by array and tile.\n");
+    printf("  -T <bytes>  Evaluate the functions on elements of this size\n");
+    printf("              (a power of two, max %d) instead of the int\n"
+           "              functions.\n", MAX_ELEMENT_SIZE);
     printf("  -M <rows>   Number of matrix rows (max %d)\n", MAXN);
     printf("  -N <cols>   Number of  matrix columns (max %d)\n", MAXN);
+    printf("  -s <num>    Number of set index bits (default 5).\n");
+    printf("  -E <num>    Number of lines per set (default 1).\n");
+    printf("  -b <num>    Number of block offset bits (default 5).\n");
     printf("Example: %s -M 8 -N 8\n", argv[0]);       
 }
 
+/*
+ * kill_children - Kill the process groups of the children still
+ *     evaluating functions, so none outlives test-trans
+ */
+static void kill_children(void)
+{
+    int i;
+
+    for (i = 0; i < func_counter; i++)
+        if (children[i] > 0)
+            kill(-children[i], SIGKILL);
+}
+
 /*
  * sigsegv_handler - SIGSEGV handler
  */
@@ -186,20 +893,32 @@ void sigsegv_handler(int signum){
  * sigalrm_handler - SIGALRM handler
  */
 void sigalrm_handler(int signum){
+    kill_children();
     printf("Error: Program timed out.\n");
     printf("TEST_TRANS_RESULTS=0:0\n");
     fflush(stdout);
     exit(1);
 }
 
+/*
+ * sigint_handler - SIGINT and SIGTERM handler: kill the children, then
+ *     die of the signal
+ */
+void sigint_handler(int signum){
+    kill_children();
+    signal(signum, SIG_DFL);
+    raise(signum);
+}
+
 /* 
  * main - Main routine
  */
 int main(int argc, char* argv[])
 {
     char c;
+    int s = 5, E = 1, b = 5; /* the graded cache */
 
-    while ((c = getopt(argc,argv,"M:N:h")) != -1) {
+    while ((c = getopt(argc,argv,"M:N:T:j:s:E:b:A:hBGOV")) != -1) {
         switch(c) {
         case 'M':
             M = atoi(optarg);
@@ -210,6 +929,36 @@ int main(int argc, char* argv[])
         case 'h':
             usage(argv);
             exit(0);
+        case 'B':
+            use_bench = 1;
+            break;
+        case 'T':
+            element_size = atoi(optarg);
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 'A':
+            attribute_func = atoi(optarg);
+            break;
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 'G':
+            use_sweep = 1;
+            break;
+        case 'O':
+            use_optimized = 1;
+            break;
+        case 'V':
+            use_valgrind = 1;
+            break;
         default:
             usage(argv);
             exit(1);
@@ -222,6 +971,39 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
+    /* The typed functions come in power-of-two sizes */
+    if (element_size < 0 || element_size > MAX_ELEMENT_SIZE ||
+        (element_size & (element_size - 1)) ||
+        (element_size && use_bench)) {
+        printf("Error: Invalid element size, or -T with -B\n");
+        usage(argv);
+        exit(1);
+    }
+
+    if (s < 0 || E <= 0 || b < 0 || s + b > 32) {
+        printf("Error: Invalid cache geometry\n");
+        usage(argv);
+        exit(1);
+    }
+
+    if (jobs <= 0 || jobs > MAX_TRANS_FUNCS) {
+        printf("Error: Invalid number of workers\n");
+        usage(argv);
+        exit(1);
+    }
+
+    if ((use_sweep || attribute_func >= 0) && (use_valgrind || use_optimized)) {
+        printf("Error: -G and -A need the in-process tracer\n");
+        usage(argv);
+        exit(1);
+    }
+
+    if (use_valgrind && use_optimized) {
+        printf("Error: -O and -V are exclusive\n");
+        usage(argv);
+        exit(1);
+    }
+
     if (M > MAXN || N > MAXN) {
         printf("Error: M or N exceeds %d\n", MAXN);
         usage(argv);
@@ -239,11 +1021,26 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
+    /* The children lead their own process groups, out of reach of the
+       terminal, so take them down with test-trans */
+    signal(SIGINT, sigint_handler);
+    signal(SIGTERM, sigint_handler);
+
     /* Time out and give up after a while */
     alarm(120);
 
     /* Check the performance of the student's transpose function */
-    eval_perf(5, 1, 5);
+    eval_perf(s, E, b);
+    if (use_sweep)
+        print_sweep();
+    if (attribute_func >= 0)
+        print_attribution();
+    if (use_bench)
+        print_bench();
+
+    /* The submission is an int function, so -T has nothing to grade */
+    if (element_size)
+        return 0;
   
     /* Emit the results for this particular test */
     if (results.funcid == -1) {
@@ -0,0 +1,51 @@
+#include "trace.h"
+
+static bool scan_access(t_trace *trace);
+
+void close_trace(t_trace *trace) {
+    fclose(trace->file);
+    trace->file = NULL;
+    trace->has_next = false;
+}
+
+void init_trace(t_trace *trace, FILE *file, size_t b, bool collapse) {
+    trace->file = file;
+    trace->b = b;
+    trace->collapse = collapse;
+    trace->position = ftell(file);
+    trace->has_next = scan_access(trace);
+}
+
+bool read_record(t_trace *trace, t_record *record) {
+    uint64_t block;
+
+    if (!trace->has_next)
+        return false;
+    *record = trace->next;
+    block = record->address >> trace->b;
+    while ((trace->has_next = scan_access(trace))) {
+        if (!trace->collapse || trace->next.address >> trace->b != block)
+            break;
+        record->hits += 1 + trace->next.hits;
+    }
+    return true;
+}
+
+/*
+ * Reads the next data access into `trace->next`, leaving `trace->offset` at
+ * its start so that a later run can seek back to it.
+ */
+static bool scan_access(t_trace *trace) {
+    t_record *record = &trace->next;
+    int length;
+
+    do {
+        trace->offset = trace->position;
+        if (fscanf(trace->file, " %c %lx,%zu%n", &record->operation,
+                   &record->address, &record->size, &length) != 3)
+            return false;
+        trace->position += length;
+    } while (record->operation == 'I');
+    record->hits = record->operation == 'M';
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A record stands for a run of consecutive accesses to the same block.
+ * Only the first access of the run has to be simulated: it leaves the
+ * block most recently used, so every later access of the run is a hit
+ * that does not change the LRU order. `hits` counts those hits, plus
+ * the store half of each 'M' access in the run.
+ */
+typedef struct s_record {
+    char operation;
+    uint64_t address;
+    size_t size;
+    size_t hits;
+} t_record;
+
+typedef struct s_trace {
+    FILE *file;
+    size_t b;
+    bool collapse;
+    bool has_next;
+    long offset, position;
+    t_record next;
+} t_trace;
+
+void close_trace(t_trace *trace);
+void init_trace(t_trace *trace, FILE *file, size_t b, bool collapse);
+bool read_record(t_trace *trace, t_record *record);
+
+#endif
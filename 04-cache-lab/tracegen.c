@@ -5,6 +5,12 @@
  * The beginning and end of each registered transpose function's trace
  * is indicated by reading from "marker" addresses. These two marker
  * addresses are recorded in file for later use.
+ *
+ * Built with -DMEMTRACE against an instrumented trans.c, as tracegen-opt,
+ * it needs no valgrind: memtrace.c records the accesses of the transpose
+ * function itself, and tracegen writes them out in the format of
+ * valgrind's lackey tool, between stores to the markers. The functions
+ * then run at nearly native speed, and can be traced as optimized.
  */
 
 #include <stdlib.h>
@@ -14,6 +20,12 @@
 #include <getopt.h>
 #include "cachelab.h"
 #include <string.h>
+#ifdef MEMTRACE
+#include "memtrace.h"
+
+/* Records buffered between writes of the trace */
+#define RING_RECORDS 65536
+#endif
 
 /* External variables declared in cachelab.c */
 extern trans_func_t func_list[MAX_TRANS_FUNCS];
@@ -30,6 +42,11 @@ static int B[256][256];
 static int M;
 static int N;
 
+/* Matrices of the typed functions, run with -T */
+static int element_size;
+static long long TA[256 * 256 * MAX_ELEMENT_SIZE / sizeof(long long)];
+static long long TB[256 * 256 * MAX_ELEMENT_SIZE / sizeof(long long)];
+
 
 int validate(int fn,int M, int N, int A[N][M], int B[M][N]) {
     int C[M][N];
@@ -46,12 +63,77 @@ int validate(int fn,int M, int N, int A[N][M], int B[M][N]) {
     return 1;
 }
 
+/*
+ * validate_typed - Check that TB holds the transpose of TA, element by
+ *     element of element_size bytes
+ */
+int validate_typed(int fn, int M, int N) {
+    char *a = (char *)TA, *b = (char *)TB;
+    for(int i=0;i<N;i++) {
+        for(int j=0;j<M;j++) {
+            if(memcmp(a + ((size_t)i*M+j)*element_size,
+                      b + ((size_t)j*N+i)*element_size, element_size)) {
+                printf("Validation failed on function %d at B[%d][%d]\n",fn,j,i);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+#ifdef MEMTRACE
+static t_memtrace trace;
+
+/*
+ * write_records - Write the buffered records to stdout as lackey does,
+ *     leaving out stack accesses as the valgrind traces are filtered
+ */
+static void write_records(t_memtrace *trace, void *context) {
+    size_t j;
+
+    for (j = 0; j < trace->length; j++) {
+        if (!is_stack_access(trace, &trace->records[j]))
+            printf(" %c %llx,%zu\n", trace->records[j].operation,
+                   (unsigned long long)trace->records[j].address,
+                   trace->records[j].size);
+    }
+}
+#endif
+
+/*
+ * run_function - Run function i between the markers and validate it
+ */
+int run_function(int i) {
+    prepareTransFunction(i, M, N, A, B);
+#ifdef MEMTRACE
+    printf(" S %llx,1\n", (unsigned long long)&MARKER_START);
+    start_memtrace(&trace);
+#endif
+    MARKER_START = 33;
+    if (func_list[i].typed_ptr)
+        (*func_list[i].typed_ptr)(M, N, TA, TB);
+    else if (func_list[i].inplace_ptr)
+        (*func_list[i].inplace_ptr)(M, N, &B[0][0]);
+    else
+        (*func_list[i].func_ptr)(M, N, A, B);
+    MARKER_END = 34;
+#ifdef MEMTRACE
+    stop_memtrace();
+    printf(" S %llx,1\n", (unsigned long long)&MARKER_END);
+    fflush(stdout);
+#endif
+    if (element_size)
+        return validate_typed(i, M, N);
+    return validate(i, M, N, A, B);
+}
+
 int main(int argc, char* argv[]){
     int i;
 
     char c;
     int selectedFunc=-1;
-    while( (c=getopt(argc,argv,"M:N:F:")) != -1){
+    char *marker_file = ".marker";
+    while( (c=getopt(argc,argv,"M:N:F:T:m:")) != -1){
         switch(c){
         case 'M':
             M = atoi(optarg);
@@ -62,6 +144,12 @@ int main(int argc, char* argv[]){
         case 'F':
             selectedFunc = atoi(optarg);
             break;
+        case 'T':
+            element_size = atoi(optarg);
+            break;
+        case 'm':
+            marker_file = optarg;
+            break;
         case '?':
         default:
             printf("./tracegen failed to parse its options.\n");
@@ -70,14 +158,28 @@ int main(int argc, char* argv[]){
     }
   
 
+    if (element_size < 0 || element_size > MAX_ELEMENT_SIZE) {
+        printf("./tracegen: element size must be at most %d bytes.\n",
+               MAX_ELEMENT_SIZE);
+        exit(1);
+    }
+
     /*  Register transpose functions */
     registerFunctions();
 
+#ifdef MEMTRACE
+    stream_memtrace(&trace, RING_RECORDS, write_records, NULL);
+#endif
+
     /* Fill A with data */
     initMatrix(M,N, A, B); 
+    for (size_t k = 0; k < (size_t)M * N * element_size; k++) {
+        ((char *)TA)[k] = rand();
+        ((char *)TB)[k] = rand();
+    }
 
     /* Record marker addresses */
-    FILE* marker_fp = fopen(".marker","w");
+    FILE* marker_fp = fopen(marker_file,"w");
     assert(marker_fp);
     fprintf(marker_fp, "%llx %llx", 
             (unsigned long long int) &MARKER_START,
@@ -85,21 +187,16 @@ int main(int argc, char* argv[]){
     fclose(marker_fp);
 
     if (-1==selectedFunc) {
-        /* Invoke registered transpose functions */
+        /* Invoke registered transpose functions of the selected type */
         for (i=0; i < func_counter; i++) {
-            MARKER_START = 33;
-            (*func_list[i].func_ptr)(M, N, A, B);
-            MARKER_END = 34;
-            if (!validate(i,M,N,A,B))
+            if (func_list[i].size != element_size)
+                continue;
+            if (!run_function(i))
                 return i+1;
         }
     } else {
-        MARKER_START = 33;
-        (*func_list[selectedFunc].func_ptr)(M, N, A, B);
-        MARKER_END = 34;
-        if (!validate(selectedFunc,M,N,A,B))
+        if (!run_function(selectedFunc))
             return selectedFunc+1;
-
     }
     return 0;
 }
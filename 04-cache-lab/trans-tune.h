@@ -0,0 +1,12 @@
+/*
+ * trans-tune.h - Blockings picked by tune-trans; regenerate with make tune
+ *
+ * Generated by: ./tune-trans -s 5 -E 1 -b 5 -o trans-tune.h 32x32 64x64 61x67
+ */
+trans_tuning_t trans_tunings[MAX_TRANS_TUNINGS] = {
+    /* M, N, rows, cols, order, diagonal */
+    {32, 32, 1, 8, 1, 1}, /* 289 misses */
+    {64, 64, 1, 4, 1, 1}, /* 1750 misses */
+    {61, 67, 1, 17, 1, 1}, /* 1810 misses */
+    {0}
+};
@@ -7,18 +7,71 @@
  * A transpose function is evaluated by counting the number of misses
  * on a 1KB direct mapped cache with a block size of 32 bytes.
  */ 
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <immintrin.h>
 #include "cachelab.h"
+#include "trans-tune.h"
+#include "trans-gen.h"
 
 #define BLOCK_SIZE 8
 #define BLOCK_SIZE_HALF 4
-#define BLOCK_SIZE_61x67 23
+
+/* Geometry of the graded cache, in ints */
+#define CACHE_INTS (1024 / (int)sizeof(int))
+#define LINE_INTS (32 / (int)sizeof(int))
+#define MAX_TILE_SIZE 23
+
+/* A cache's worth of lines, aligned so that its k-th line maps to set k,
+   for blocks staged outside A and B */
+static int stage_buffer[CACHE_INTS]
+    __attribute__((aligned(CACHE_INTS * sizeof(int))));
+
+/* Tiles of the parallel transpose: a 64-byte line of A and of B */
+#define LINE_TILE_SIZE 16
+
+/* Matrices of a batch whose tiles are interleaved */
+#define BATCH_GROUP 4
 
 int is_transpose(int M, int N, int A[N][M], int B[M][N]);
 
-static void transpose_32x32(int M, int N, int A[N][M], int B[M][N]);
-static void transpose_64x64(int M, int N, int A[N][M], int B[M][N]);
-static void transpose_61x67(int M, int N, int A[N][M], int B[M][N]);
+static int conflict_distance(int stride);
+static int cache_set(const int *p);
+static void transpose_blocked(int M, int N, int A[N][M], int B[M][N]);
+static void transpose_blocked_split(int M, int N, int A[N][M], int B[M][N]);
+static void transpose_staged(int M, int N, int A[N][M], int B[M][N]);
+static void transpose_generic(int M, int N, int A[N][M], int B[M][N]);
+static void transpose_tiled(int M, int N, int A[N][M], int B[M][N],
+                            int r_begin, int r_end, int c_begin, int c_end,
+                            int tile);
+static void transpose_tile(int M, int N, int A[N][M], int B[M][N],
+                           int r0, int r_end, int c0, int c_end,
+                           int order, int diagonal);
+static void transpose_tuned(int M, int N, int A[N][M], int B[M][N]);
+static void transpose_blocking(int M, int N, int A[N][M], int B[M][N],
+                               const trans_tuning_t *tuning);
+static void transpose_recursive(int M, int N, int A[N][M], int B[M][N]);
+static void transpose_split(int M, int N, int A[N][M], int B[M][N],
+                            int r_begin, int r_end, int c_begin, int c_end);
+static void transpose_simd(int M, int N, int A[N][M], int B[M][N]);
+void transpose_inplace_square(int M, int N, int *A);
+void transpose_inplace_cycles(int M, int N, int *A);
+static void transpose_avx2(int M, int N, int A[N][M], int B[M][N]);
+static void transpose_sse2(int M, int N, int A[N][M], int B[M][N]);
+static void transpose_tile_avx2(int M, int N, int A[N][M], int B[M][N],
+                                int r0, int c0, int stream);
+static void transpose_band_avx2(int M, int N, int A[N][M], int B[M][N],
+                                int c_begin, int c_end);
+void transpose_parallel(int M, int N, int A[N][M], int B[M][N],
+                        int thread, int threads);
+void transpose_batch(int M, int N, int count, int *const A[],
+                     int *const B[]);
+static void transpose_batch_avx2(int M, int N, int count, int *const A[],
+                                 int *const B[]);
+void transpose_batch_interleaved(int M, int N, int count, const int *A,
+                                 int *B);
 
 /* 
  * transpose_submit - This is the solution transpose function that you
@@ -29,20 +82,80 @@ static void transpose_61x67(int M, int N, int A[N][M], int B[M][N]);
  */
 char transpose_submit_desc[] = "Transpose submission";
 void transpose_submit(int M, int N, int A[N][M], int B[M][N]) {
-    if (M == 32 && N == 32)
-        transpose_32x32(M, N, A, B);
-    else if (M == 64 && N == 64)
-        transpose_64x64(M, N, A, B);
-    else if (M == 61 && N == 67)
-        transpose_61x67(M, N, A, B);
+    if (M == 61 && N == 67)
+        transpose_tuned(M, N, A, B);
+    else
+        transpose_generic(M, N, A, B);
+}
+
+/*
+ * transpose_generic - Picks a blocking from how many consecutive rows of
+ *     each matrix fit in the cache before they collide: 8x8 blocks when 8
+ *     rows of B fit (32x32), 8x8 blocks split into 4x4 quarters when only 4
+ *     rows fit (64x64), and 8x8 blocks staged through a buffer when fewer
+ *     rows fit (128x128 and up). These only move whole blocks; the strips
+ *     left at ragged edges (61x67) go in tiles sized to B's stride.
+ */
+char transpose_generic_desc[] = "Generic cache-aware transpose";
+static void transpose_generic(int M, int N, int A[N][M], int B[M][N]) {
+    int a_distance = conflict_distance(M);
+    int b_distance = conflict_distance(N);
+    int m_whole = M - M % BLOCK_SIZE, n_whole = N - N % BLOCK_SIZE;
+    int tile;
+
+    if (b_distance >= BLOCK_SIZE) {
+        transpose_blocked(M, N, A, B);
+    } else if (b_distance < BLOCK_SIZE_HALF) {
+        transpose_staged(M, N, A, B);
+    } else if (a_distance >= BLOCK_SIZE_HALF) {
+        transpose_blocked_split(M, N, A, B);
+    } else {
+        transpose_tiled(M, N, A, B, 0, N, 0, M, BLOCK_SIZE_HALF);
+        return;
+    }
+
+    tile = b_distance;
+    if (tile < BLOCK_SIZE_HALF)
+        tile = BLOCK_SIZE_HALF;
+    if (tile > MAX_TILE_SIZE)
+        tile = MAX_TILE_SIZE;
+    transpose_tiled(M, N, A, B, 0, n_whole, m_whole, M, tile);
+    transpose_tiled(M, N, A, B, n_whole, N, 0, M, tile);
+}
+
+/*
+ * conflict_distance - How many rows apart two rows of a matrix with the
+ *     given stride start on the same cache set, give or take a line
+ */
+static int conflict_distance(int stride) {
+    int k, offset;
+
+    for (k = 1; k < CACHE_INTS; ++k) {
+        offset = k * stride % CACHE_INTS;
+        if (offset < LINE_INTS || offset > CACHE_INTS - LINE_INTS)
+            break;
+    }
+    return k;
+}
+
+/*
+ * cache_set - The set of the graded cache that an address maps to
+ */
+static int cache_set(const int *p) {
+    return (uintptr_t)p / (LINE_INTS * sizeof(int)) %
+           (CACHE_INTS / LINE_INTS);
 }
 
-static void transpose_32x32(int M, int N, int A[N][M], int B[M][N]) {
+/*
+ * transpose_blocked - 8x8 blocks, moving each row of A through eight
+ *     temporaries; only whole blocks are transposed
+ */
+static void transpose_blocked(int M, int N, int A[N][M], int B[M][N]) {
     int r0, c0, r;
     int t0, t1, t2, t3, t4, t5, t6, t7;
 
-    for (r0 = 0; r0 < N; r0 += BLOCK_SIZE) {
-        for (c0 = 0; c0 < M; c0 += BLOCK_SIZE) {
+    for (r0 = 0; r0 + BLOCK_SIZE <= N; r0 += BLOCK_SIZE) {
+        for (c0 = 0; c0 + BLOCK_SIZE <= M; c0 += BLOCK_SIZE) {
             for (r = r0; r < r0 + BLOCK_SIZE; ++r) {
                 t0 = A[r][c0];
                 t1 = A[r][c0 + 1];
@@ -65,12 +178,17 @@ static void transpose_32x32(int M, int N, int A[N][M], int B[M][N]) {
     }
 }
 
-static void transpose_64x64(int M, int N, int A[N][M], int B[M][N]) {
+/*
+ * transpose_blocked_split - 8x8 blocks handled as 4x4 quarters, using the
+ *     upper right quarter of B as a buffer so that only four rows of each
+ *     matrix are live at a time; only whole blocks are transposed
+ */
+static void transpose_blocked_split(int M, int N, int A[N][M], int B[M][N]) {
     int r0, c0, r, l;
     int t0, t1, t2, t3, t4, t5, t6, t7;
 
-    for (r0 = 0; r0 < N; r0 += BLOCK_SIZE) {
-        for (c0 = 0; c0 < M; c0 += BLOCK_SIZE) {
+    for (r0 = 0; r0 + BLOCK_SIZE <= N; r0 += BLOCK_SIZE) {
+        for (c0 = 0; c0 + BLOCK_SIZE <= M; c0 += BLOCK_SIZE) {
             for (r = r0; r < r0 + BLOCK_SIZE_HALF; ++r) {
                 t0 = A[r][c0];
                 t1 = A[r][c0 + 1];
@@ -120,14 +238,502 @@ static void transpose_64x64(int M, int N, int A[N][M], int B[M][N]) {
     }
 }
 
-static void transpose_61x67(int M, int N, int A[N][M], int B[M][N]) {
+/*
+ * transpose_staged - 8x8 blocks, for when the rows of a block of B evict
+ *     each other. Each row of A is scattered across eight lines of
+ *     stage_buffer whose sets no row of the block in A or B uses, and each
+ *     row of B is then filled from one of them, so every line of A and B
+ *     is missed once per block. Only whole blocks are transposed.
+ */
+static void transpose_staged(int M, int N, int A[N][M], int B[M][N]) {
+    int r0, c0, r, c, k;
+    unsigned int used;
+    int *stage[BLOCK_SIZE];
+
+    for (r0 = 0; r0 + BLOCK_SIZE <= N; r0 += BLOCK_SIZE) {
+        for (c0 = 0; c0 + BLOCK_SIZE <= M; c0 += BLOCK_SIZE) {
+            used = 0;
+            for (r = 0; r < BLOCK_SIZE; ++r) {
+                used |= 1u << cache_set(&A[r0 + r][c0]);
+                used |= 1u << cache_set(&A[r0 + r][c0 + BLOCK_SIZE - 1]);
+                used |= 1u << cache_set(&B[c0 + r][r0]);
+                used |= 1u << cache_set(&B[c0 + r][r0 + BLOCK_SIZE - 1]);
+            }
+            for (k = 0, c = 0; c < BLOCK_SIZE; ++k)
+                if (!(used >> k & 1))
+                    stage[c++] = &stage_buffer[k * LINE_INTS];
+
+            for (r = 0; r < BLOCK_SIZE; ++r)
+                for (c = 0; c < BLOCK_SIZE; ++c)
+                    stage[c][r] = A[r0 + r][c0 + c];
+            for (c = 0; c < BLOCK_SIZE; ++c)
+                for (r = 0; r < BLOCK_SIZE; ++r)
+                    B[c0 + c][r0 + r] = stage[c][r];
+        }
+    }
+}
+
+/*
+ * transpose_tiled - Square tiles of the given size over rows [r_begin,
+ *     r_end) and columns [c_begin, c_end) of A
+ */
+static void transpose_tiled(int M, int N, int A[N][M], int B[M][N],
+                            int r_begin, int r_end, int c_begin, int c_end,
+                            int tile) {
     int r0, c0, r, c;
 
-    for (r0 = 0; r0 < N; r0 += BLOCK_SIZE_61x67)
-        for (c0 = 0; c0 < M; c0 += BLOCK_SIZE_61x67)
-            for (r = r0; r < r0 + BLOCK_SIZE_61x67 && r < N; ++r)
-                for (c = c0; c < c0 + BLOCK_SIZE_61x67 && c < M; ++c)
+    for (r0 = r_begin; r0 < r_end; r0 += tile)
+        for (c0 = c_begin; c0 < c_end; c0 += tile)
+            for (r = r0; r < r0 + tile && r < r_end; ++r)
+                for (c = c0; c < c0 + tile && c < c_end; ++c)
+                    B[c][r] = A[r][c];
+}
+
+/*
+ * transpose_tuned - The blocking tune-trans found best for this shape,
+ *     or the generic transpose for shapes missing from trans-tune.h
+ */
+char transpose_tuned_desc[] = "Tuned blocked transpose";
+static void transpose_tuned(int M, int N, int A[N][M], int B[M][N]) {
+    const trans_tuning_t *tuning;
+
+    for (tuning = trans_tunings; tuning->M; ++tuning) {
+        if (tuning->M == M && tuning->N == N) {
+            transpose_blocking(M, N, A, B, tuning);
+            return;
+        }
+    }
+    transpose_generic(M, N, A, B);
+}
+
+/*
+ * transpose_blocking - rows x cols blocks of A, visited and walked in the
+ *     order of a tune-trans table entry
+ */
+static void transpose_blocking(int M, int N, int A[N][M], int B[M][N],
+                               const trans_tuning_t *tuning) {
+    int rows = tuning->rows, cols = tuning->cols;
+    int order = tuning->order, diagonal = tuning->diagonal;
+    int r0, c0;
+
+    if (order & TUNE_BLOCKS_BY_COLUMN) {
+        for (c0 = 0; c0 < M; c0 += cols)
+            for (r0 = 0; r0 < N; r0 += rows)
+                transpose_tile(M, N, A, B, r0, r0 + rows, c0, c0 + cols,
+                               order, diagonal);
+    } else {
+        for (r0 = 0; r0 < N; r0 += rows)
+            for (c0 = 0; c0 < M; c0 += cols)
+                transpose_tile(M, N, A, B, r0, r0 + rows, c0, c0 + cols,
+                               order, diagonal);
+    }
+}
+
+/*
+ * transpose_tile - One block of transpose_blocking, clipped to the matrix.
+ *     On a diagonal, A[r][r] and B[r][r] map to the same set when the
+ *     matrices are a cache size apart, so the store of the diagonal element
+ *     can be held back until the rest of its row (or column) is moved.
+ */
+static void transpose_tile(int M, int N, int A[N][M], int B[M][N],
+                           int r0, int r_end, int c0, int c_end,
+                           int order, int diagonal) {
+    int r, c, t = 0;
+
+    if (r_end > N)
+        r_end = N;
+    if (c_end > M)
+        c_end = M;
+    if (order & TUNE_INNER_BY_COLUMN) {
+        for (c = c0; c < c_end; ++c) {
+            for (r = r0; r < r_end; ++r) {
+                if (diagonal && r == c)
+                    t = A[r][c];
+                else
+                    B[c][r] = A[r][c];
+            }
+            if (diagonal && c >= r0 && c < r_end)
+                B[c][c] = t;
+        }
+    } else {
+        for (r = r0; r < r_end; ++r) {
+            for (c = c0; c < c_end; ++c) {
+                if (diagonal && r == c)
+                    t = A[r][c];
+                else
                     B[c][r] = A[r][c];
+            }
+            if (diagonal && r >= c0 && r < c_end)
+                B[r][r] = t;
+        }
+    }
+}
+
+/*
+ * transpose_recursive - Cache-oblivious: halving the longer side of A
+ *     until a piece is at most 8x8 reaches a size that fits every cache
+ *     level at some depth, without knowing any of them
+ */
+char transpose_recursive_desc[] = "Cache-oblivious recursive transpose";
+static void transpose_recursive(int M, int N, int A[N][M], int B[M][N]) {
+    transpose_split(M, N, A, B, 0, N, 0, M);
+}
+
+/*
+ * transpose_split - Rows [r_begin, r_end) and columns [c_begin, c_end) of
+ *     A. A whole 8x8 base case is moved as two 8x4 halves, two rows of A
+ *     at a time, so that each line of B gets two values per visit: when
+ *     the rows of B collide in the cache (128x128 and up), every visit
+ *     misses, and this halves the visits of a row-at-a-time base case.
+ */
+static void transpose_split(int M, int N, int A[N][M], int B[M][N],
+                            int r_begin, int r_end, int c_begin, int c_end) {
+    int rows = r_end - r_begin, cols = c_end - c_begin;
+    int r, c, mid, t0, t1, t2, t3, t4, t5, t6, t7;
+
+    if (rows > BLOCK_SIZE || cols > BLOCK_SIZE) {
+        if (rows >= cols) {
+            mid = r_begin + rows / 2;
+            transpose_split(M, N, A, B, r_begin, mid, c_begin, c_end);
+            transpose_split(M, N, A, B, mid, r_end, c_begin, c_end);
+        } else {
+            mid = c_begin + cols / 2;
+            transpose_split(M, N, A, B, r_begin, r_end, c_begin, mid);
+            transpose_split(M, N, A, B, r_begin, r_end, mid, c_end);
+        }
+    } else if (rows == BLOCK_SIZE && cols == BLOCK_SIZE) {
+        for (c = c_begin; c < c_end; c += BLOCK_SIZE_HALF) {
+            for (r = r_begin; r < r_end; r += 2) {
+                t0 = A[r][c];
+                t1 = A[r][c + 1];
+                t2 = A[r][c + 2];
+                t3 = A[r][c + 3];
+                t4 = A[r + 1][c];
+                t5 = A[r + 1][c + 1];
+                t6 = A[r + 1][c + 2];
+                t7 = A[r + 1][c + 3];
+                B[c][r] = t0;
+                B[c][r + 1] = t4;
+                B[c + 1][r] = t1;
+                B[c + 1][r + 1] = t5;
+                B[c + 2][r] = t2;
+                B[c + 2][r + 1] = t6;
+                B[c + 3][r] = t3;
+                B[c + 3][r + 1] = t7;
+            }
+        }
+    } else {
+        transpose_tiled(M, N, A, B, r_begin, r_end, c_begin, c_end,
+                        BLOCK_SIZE);
+    }
+}
+
+/*
+ * transpose_inplace_square - In place for M == N: each 8x8 tile above the
+ *     diagonal is swapped, transposed, with its mirror below it, and the
+ *     diagonal tiles are transposed within themselves. Other shapes are
+ *     left to transpose_inplace_cycles.
+ */
+char transpose_inplace_square_desc[] = "In-place tile-swap transpose";
+void transpose_inplace_square(int M, int N, int *A) {
+    int r0, c0, r, c, t;
+
+    if (M != N) {
+        transpose_inplace_cycles(M, N, A);
+        return;
+    }
+    for (r0 = 0; r0 < N; r0 += BLOCK_SIZE) {
+        for (c0 = r0; c0 < N; c0 += BLOCK_SIZE) {
+            for (r = r0; r < r0 + BLOCK_SIZE && r < N; ++r) {
+                for (c = c0 == r0 ? r + 1 : c0; c < c0 + BLOCK_SIZE && c < N;
+                     ++c) {
+                    t = A[r * N + c];
+                    A[r * N + c] = A[c * N + r];
+                    A[c * N + r] = t;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * transpose_inplace_cycles - In place for any shape. The element at k =
+ *     r * M + c belongs at c * N + r, which is k * N mod (M * N - 1), so
+ *     the permutation splits into cycles that are each rotated once. One
+ *     bit per element marks what has been moved: 1/32 of the matrix,
+ *     instead of the whole second buffer.
+ */
+char transpose_inplace_cycles_desc[] = "In-place cycle-following transpose";
+void transpose_inplace_cycles(int M, int N, int *A) {
+    long long last = (long long)M * N - 1, start, k;
+    unsigned char *moved;
+    int t, next;
+
+    /* A row or column vector is its own transpose in memory */
+    if (last < 2)
+        return;
+    moved = calloc(last / 8 + 1, 1);
+    if (!moved) {
+        fprintf(stderr, "transpose_inplace_cycles: out of memory\n");
+        return;
+    }
+    for (start = 1; start < last; ++start) {
+        if (moved[start / 8] & 1 << start % 8)
+            continue;
+        t = A[start];
+        k = start;
+        do {
+            k = k * N % last;
+            next = A[k];
+            A[k] = t;
+            t = next;
+            moved[k / 8] |= 1 << k % 8;
+        } while (k != start);
+    }
+    free(moved);
+}
+
+/*
+ * transpose_simd - Whole tiles transposed in vector registers, using the
+ *     widest instruction set the CPU supports; the edges left over are
+ *     done by transpose_tiled
+ */
+char transpose_simd_desc[] = "SIMD register-blocked transpose";
+static void transpose_simd(int M, int N, int A[N][M], int B[M][N]) {
+    if (__builtin_cpu_supports("avx2"))
+        transpose_avx2(M, N, A, B);
+    else
+        transpose_sse2(M, N, A, B);
+}
+
+/*
+ * transpose_avx2 - 8x8 tiles moved by transpose_tile_avx2
+ */
+__attribute__((target("avx2")))
+static void transpose_avx2(int M, int N, int A[N][M], int B[M][N]) {
+    int r0, c0;
+    int r_end = N - N % BLOCK_SIZE, c_end = M - M % BLOCK_SIZE;
+
+    for (r0 = 0; r0 < r_end; r0 += BLOCK_SIZE)
+        for (c0 = 0; c0 < c_end; c0 += BLOCK_SIZE)
+            transpose_tile_avx2(M, N, A, B, r0, c0, 0);
+    transpose_tiled(M, N, A, B, 0, r_end, c_end, M, BLOCK_SIZE);
+    transpose_tiled(M, N, A, B, r_end, N, 0, M, BLOCK_SIZE);
+}
+
+/*
+ * transpose_tile_avx2 - The 8x8 tile of A at (r0, c0): each row of A is
+ *     one register, and three rounds of unpacks and lane permutes turn
+ *     them into rows of B. Streaming stores need B's rows 32-byte aligned.
+ */
+__attribute__((target("avx2")))
+static void transpose_tile_avx2(int M, int N, int A[N][M], int B[M][N],
+                                int r0, int c0, int stream) {
+    __m256i a0, a1, a2, a3, a4, a5, a6, a7;
+    __m256i t0, t1, t2, t3, t4, t5, t6, t7;
+
+    a0 = _mm256_loadu_si256((const __m256i *)&A[r0][c0]);
+    a1 = _mm256_loadu_si256((const __m256i *)&A[r0 + 1][c0]);
+    a2 = _mm256_loadu_si256((const __m256i *)&A[r0 + 2][c0]);
+    a3 = _mm256_loadu_si256((const __m256i *)&A[r0 + 3][c0]);
+    a4 = _mm256_loadu_si256((const __m256i *)&A[r0 + 4][c0]);
+    a5 = _mm256_loadu_si256((const __m256i *)&A[r0 + 5][c0]);
+    a6 = _mm256_loadu_si256((const __m256i *)&A[r0 + 6][c0]);
+    a7 = _mm256_loadu_si256((const __m256i *)&A[r0 + 7][c0]);
+
+    /* Interleave pairs of rows: 2x2 blocks within each lane */
+    t0 = _mm256_unpacklo_epi32(a0, a1);
+    t1 = _mm256_unpackhi_epi32(a0, a1);
+    t2 = _mm256_unpacklo_epi32(a2, a3);
+    t3 = _mm256_unpackhi_epi32(a2, a3);
+    t4 = _mm256_unpacklo_epi32(a4, a5);
+    t5 = _mm256_unpackhi_epi32(a4, a5);
+    t6 = _mm256_unpacklo_epi32(a6, a7);
+    t7 = _mm256_unpackhi_epi32(a6, a7);
+
+    /* Interleave pairs of pairs: 4x4 blocks within each lane */
+    a0 = _mm256_unpacklo_epi64(t0, t2);
+    a1 = _mm256_unpackhi_epi64(t0, t2);
+    a2 = _mm256_unpacklo_epi64(t1, t3);
+    a3 = _mm256_unpackhi_epi64(t1, t3);
+    a4 = _mm256_unpacklo_epi64(t4, t6);
+    a5 = _mm256_unpackhi_epi64(t4, t6);
+    a6 = _mm256_unpacklo_epi64(t5, t7);
+    a7 = _mm256_unpackhi_epi64(t5, t7);
+
+    /* Swap the off-diagonal 4x4 blocks across lanes */
+    t0 = _mm256_permute2x128_si256(a0, a4, 0x20);
+    t1 = _mm256_permute2x128_si256(a1, a5, 0x20);
+    t2 = _mm256_permute2x128_si256(a2, a6, 0x20);
+    t3 = _mm256_permute2x128_si256(a3, a7, 0x20);
+    t4 = _mm256_permute2x128_si256(a0, a4, 0x31);
+    t5 = _mm256_permute2x128_si256(a1, a5, 0x31);
+    t6 = _mm256_permute2x128_si256(a2, a6, 0x31);
+    t7 = _mm256_permute2x128_si256(a3, a7, 0x31);
+
+    if (stream) {
+        _mm256_stream_si256((__m256i *)&B[c0][r0], t0);
+        _mm256_stream_si256((__m256i *)&B[c0 + 1][r0], t1);
+        _mm256_stream_si256((__m256i *)&B[c0 + 2][r0], t2);
+        _mm256_stream_si256((__m256i *)&B[c0 + 3][r0], t3);
+        _mm256_stream_si256((__m256i *)&B[c0 + 4][r0], t4);
+        _mm256_stream_si256((__m256i *)&B[c0 + 5][r0], t5);
+        _mm256_stream_si256((__m256i *)&B[c0 + 6][r0], t6);
+        _mm256_stream_si256((__m256i *)&B[c0 + 7][r0], t7);
+    } else {
+        _mm256_storeu_si256((__m256i *)&B[c0][r0], t0);
+        _mm256_storeu_si256((__m256i *)&B[c0 + 1][r0], t1);
+        _mm256_storeu_si256((__m256i *)&B[c0 + 2][r0], t2);
+        _mm256_storeu_si256((__m256i *)&B[c0 + 3][r0], t3);
+        _mm256_storeu_si256((__m256i *)&B[c0 + 4][r0], t4);
+        _mm256_storeu_si256((__m256i *)&B[c0 + 5][r0], t5);
+        _mm256_storeu_si256((__m256i *)&B[c0 + 6][r0], t6);
+        _mm256_storeu_si256((__m256i *)&B[c0 + 7][r0], t7);
+    }
+}
+
+/*
+ * transpose_sse2 - 4x4 tiles, the baseline for every x86-64 CPU
+ */
+static void transpose_sse2(int M, int N, int A[N][M], int B[M][N]) {
+    int r0, c0;
+    int r_end = N - N % BLOCK_SIZE_HALF, c_end = M - M % BLOCK_SIZE_HALF;
+    __m128i a0, a1, a2, a3, t0, t1, t2, t3;
+
+    for (r0 = 0; r0 < r_end; r0 += BLOCK_SIZE_HALF) {
+        for (c0 = 0; c0 < c_end; c0 += BLOCK_SIZE_HALF) {
+            a0 = _mm_loadu_si128((const __m128i *)&A[r0][c0]);
+            a1 = _mm_loadu_si128((const __m128i *)&A[r0 + 1][c0]);
+            a2 = _mm_loadu_si128((const __m128i *)&A[r0 + 2][c0]);
+            a3 = _mm_loadu_si128((const __m128i *)&A[r0 + 3][c0]);
+            t0 = _mm_unpacklo_epi32(a0, a1);
+            t1 = _mm_unpackhi_epi32(a0, a1);
+            t2 = _mm_unpacklo_epi32(a2, a3);
+            t3 = _mm_unpackhi_epi32(a2, a3);
+            _mm_storeu_si128((__m128i *)&B[c0][r0], _mm_unpacklo_epi64(t0, t2));
+            _mm_storeu_si128((__m128i *)&B[c0 + 1][r0],
+                             _mm_unpackhi_epi64(t0, t2));
+            _mm_storeu_si128((__m128i *)&B[c0 + 2][r0],
+                             _mm_unpacklo_epi64(t1, t3));
+            _mm_storeu_si128((__m128i *)&B[c0 + 3][r0],
+                             _mm_unpackhi_epi64(t1, t3));
+        }
+    }
+    transpose_tiled(M, N, A, B, 0, r_end, c_end, M, BLOCK_SIZE_HALF);
+    transpose_tiled(M, N, A, B, r_end, N, 0, M, BLOCK_SIZE_HALF);
+}
+
+/*
+ * transpose_parallel - Thread `thread` of `threads` writes its own band of
+ *     rows of B, which is a contiguous range of memory: the pages of a
+ *     band stay with the thread (and NUMA node) that first wrote them,
+ *     and no two threads ever share a line of B
+ */
+char transpose_parallel_desc[] = "Parallel streaming transpose";
+void transpose_parallel(int M, int N, int A[N][M], int B[M][N],
+                        int thread, int threads) {
+    int tiles = M / LINE_TILE_SIZE;
+    int c_begin = tiles * thread / threads * LINE_TILE_SIZE;
+    int c_end = tiles * (thread + 1) / threads * LINE_TILE_SIZE;
+
+    /* The columns past the last whole tile go to the last thread */
+    if (thread == threads - 1)
+        c_end = M;
+    if (__builtin_cpu_supports("avx2"))
+        transpose_band_avx2(M, N, A, B, c_begin, c_end);
+    else
+        transpose_tiled(M, N, A, B, 0, N, c_begin, c_end, BLOCK_SIZE);
+}
+
+/*
+ * transpose_band_avx2 - Columns [c_begin, c_end) of A in 16x16 tiles, so
+ *     that every load of A and every store to B covers a whole line. The
+ *     two 8x8 tiles that fill the same lines of B are written back to back,
+ *     letting streaming stores combine into full-line writes that skip the
+ *     cache: B is not read again by this thread.
+ */
+__attribute__((target("avx2")))
+static void transpose_band_avx2(int M, int N, int A[N][M], int B[M][N],
+                                int c_begin, int c_end) {
+    int r0, c0;
+    int r_end = N - N % LINE_TILE_SIZE;
+    int c_tiles = c_begin + (c_end - c_begin) / LINE_TILE_SIZE * LINE_TILE_SIZE;
+    int stream = N % BLOCK_SIZE == 0 && (long)B % 32 == 0;
+
+    for (c0 = c_begin; c0 < c_tiles; c0 += LINE_TILE_SIZE) {
+        for (r0 = 0; r0 < r_end; r0 += LINE_TILE_SIZE) {
+            transpose_tile_avx2(M, N, A, B, r0, c0, stream);
+            transpose_tile_avx2(M, N, A, B, r0 + BLOCK_SIZE, c0, stream);
+            transpose_tile_avx2(M, N, A, B, r0, c0 + BLOCK_SIZE, stream);
+            transpose_tile_avx2(M, N, A, B, r0 + BLOCK_SIZE, c0 + BLOCK_SIZE,
+                                stream);
+        }
+    }
+    if (stream)
+        _mm_sfence();
+    transpose_tiled(M, N, A, B, r_end, N, c_begin, c_tiles, BLOCK_SIZE);
+    transpose_tiled(M, N, A, B, 0, N, c_tiles, c_end, BLOCK_SIZE);
+}
+
+/*
+ * transpose_batch - Transposes count N x M matrices A[k] into the M x N
+ *     matrices B[k]. The kernel is picked once for the whole batch; with
+ *     AVX2, the tiles of BATCH_GROUP matrices are interleaved so that
+ *     the shuffles of one overlap the loads and stores of the others.
+ */
+void transpose_batch(int M, int N, int count, int *const A[],
+                     int *const B[]) {
+    int k;
+
+    if (__builtin_cpu_supports("avx2")) {
+        transpose_batch_avx2(M, N, count, A, B);
+        return;
+    }
+    for (k = 0; k < count; ++k)
+        transpose_submit(M, N, (void *)A[k], (void *)B[k]);
+}
+
+__attribute__((target("avx2")))
+static void transpose_batch_avx2(int M, int N, int count, int *const A[],
+                                 int *const B[]) {
+    int k0, k, k_end, r0, c0;
+    int r_end = N - N % BLOCK_SIZE, c_end = M - M % BLOCK_SIZE;
+
+    for (k0 = 0; k0 < count; k0 += BATCH_GROUP) {
+        k_end = k0 + BATCH_GROUP < count ? k0 + BATCH_GROUP : count;
+        for (r0 = 0; r0 < r_end; r0 += BLOCK_SIZE)
+            for (c0 = 0; c0 < c_end; c0 += BLOCK_SIZE)
+                for (k = k0; k < k_end; ++k)
+                    transpose_tile_avx2(M, N, (void *)A[k], (void *)B[k], r0,
+                                        c0, 0);
+        for (k = k0; k < k_end; ++k) {
+            transpose_tiled(M, N, (void *)A[k], (void *)B[k], 0, r_end,
+                            c_end, M, BLOCK_SIZE);
+            transpose_tiled(M, N, (void *)A[k], (void *)B[k], r_end, N, 0,
+                            M, BLOCK_SIZE);
+        }
+    }
+}
+
+/*
+ * transpose_batch_interleaved - Transposes count matrices stored
+ *     interleaved: element (r, c) of matrix k of A is at
+ *     A[(r * M + c) * count + k], and likewise in B for the transposed
+ *     shape. Each element position then moves a contiguous vector of
+ *     count ints, one per matrix, which is copied with full-width
+ *     vector loads and stores whatever the shape.
+ */
+void transpose_batch_interleaved(int M, int N, int count, const int *A,
+                                 int *B) {
+    size_t vector = (size_t)count * sizeof(int);
+    int r0, c0, r, c;
+
+    for (r0 = 0; r0 < N; r0 += BLOCK_SIZE)
+        for (c0 = 0; c0 < M; c0 += BLOCK_SIZE)
+            for (r = r0; r < r0 + BLOCK_SIZE && r < N; ++r)
+                for (c = c0; c < c0 + BLOCK_SIZE && c < M; ++c)
+                    memcpy(&B[((size_t)c * N + r) * count],
+                           &A[((size_t)r * M + c) * count], vector);
 }
 
 /* 
@@ -152,6 +758,79 @@ void trans(int M, int N, int A[N][M], int B[M][N])
 
 }
 
+/*
+ * DEFINE_TYPED_TRANSPOSES - A row-wise scan and a blocked transpose of
+ *     `type` elements. Blocks are `rows` x `cols` elements of A, chosen
+ *     per type since a 32-byte line holds 32 / sizeof(type) of them; as
+ *     in transpose_tile, the store of a diagonal element waits for the
+ *     rest of its row.
+ */
+#define DEFINE_TYPED_TRANSPOSES(name, type, rows, cols)                     \
+    char transpose_##name##_scan_desc[] = #name " row-wise scan";           \
+    static void transpose_##name##_scan(int M, int N, void *a, void *b) {   \
+        type (*A)[M] = a;                                                   \
+        type (*B)[N] = b;                                                   \
+        int r, c;                                                           \
+                                                                            \
+        for (r = 0; r < N; ++r)                                             \
+            for (c = 0; c < M; ++c)                                         \
+                B[c][r] = A[r][c];                                          \
+    }                                                                       \
+                                                                            \
+    char transpose_##name##_blocked_desc[] =                                \
+        #name " blocked " #rows "x" #cols;                                  \
+    static void transpose_##name##_blocked(int M, int N, void *a, void *b) {\
+        type (*A)[M] = a;                                                   \
+        type (*B)[N] = b;                                                   \
+        type diagonal = {0};                                                \
+        int r0, c0, r, c;                                                   \
+                                                                            \
+        for (r0 = 0; r0 < N; r0 += rows) {                                  \
+            for (c0 = 0; c0 < M; c0 += cols) {                              \
+                for (r = r0; r < r0 + rows && r < N; ++r) {                 \
+                    for (c = c0; c < c0 + cols && c < M; ++c) {             \
+                        if (r == c)                                         \
+                            diagonal = A[r][c];                             \
+                        else                                                \
+                            B[c][r] = A[r][c];                              \
+                    }                                                       \
+                    if (r >= c0 && r < c)                                   \
+                        B[r][r] = diagonal;                                 \
+                }                                                           \
+            }                                                               \
+        }                                                                   \
+    }
+
+#define REGISTER_TYPED_TRANSPOSES(name, type)                               \
+    do {                                                                    \
+        registerTypedTransFunction(transpose_##name##_scan, sizeof(type),   \
+                                   transpose_##name##_scan_desc);           \
+        registerTypedTransFunction(transpose_##name##_blocked,              \
+                                   sizeof(type),                            \
+                                   transpose_##name##_blocked_desc);        \
+    } while (0)
+
+/* A 16-byte element, such as a pair of indices or a complex double */
+typedef struct pair16 {
+    int64_t first;
+    int64_t second;
+} pair16_t;
+
+/*
+ * Blocks half a line wide and 16 rows tall (32 for bytes) took the fewest
+ * misses over 32x32, 64x64 and 61x67 on the graded cache, out of all
+ * shapes from 2 to 32 a side: a block of B then spans at most half the
+ * sets, whatever the stride. A pair16 element is already half a line, so
+ * its blocks are a whole line wide; one element wide, they took 12527
+ * misses over the three shapes to the 11773 of 16x2.
+ */
+DEFINE_TYPED_TRANSPOSES(int8, int8_t, 32, 16)
+DEFINE_TYPED_TRANSPOSES(int16, int16_t, 16, 8)
+DEFINE_TYPED_TRANSPOSES(float, float, 16, 4)
+DEFINE_TYPED_TRANSPOSES(double, double, 16, 2)
+DEFINE_TYPED_TRANSPOSES(int64, int64_t, 16, 2)
+DEFINE_TYPED_TRANSPOSES(pair16, pair16_t, 16, 2)
+
 /*
  * registerFunctions - This function registers your transpose
  *     functions with the driver.  At runtime, the driver will
@@ -166,6 +845,28 @@ void registerFunctions()
 
     /* Register any additional transpose functions */
     registerTransFunction(trans, trans_desc); 
+    registerTransFunction(transpose_generic, transpose_generic_desc);
+    registerTransFunction(transpose_tuned, transpose_tuned_desc);
+    registerTransFunction(transpose_simd, transpose_simd_desc);
+    registerTransFunction(transpose_recursive, transpose_recursive_desc);
+    registerInPlaceTransFunction(transpose_inplace_square,
+                                 transpose_inplace_square_desc);
+    registerInPlaceTransFunction(transpose_inplace_cycles,
+                                 transpose_inplace_cycles_desc);
+
+    /* Register the unrolled kernels emitted by gen-trans */
+    REGISTER_GENERATED_TRANSPOSES();
+
+    /* Register the transposes of other element types, run with -T */
+    REGISTER_TYPED_TRANSPOSES(int8, int8_t);
+    REGISTER_TYPED_TRANSPOSES(int16, int16_t);
+    REGISTER_TYPED_TRANSPOSES(float, float);
+    REGISTER_TYPED_TRANSPOSES(double, double);
+    REGISTER_TYPED_TRANSPOSES(int64, int64_t);
+    REGISTER_TYPED_TRANSPOSES(pair16, pair16_t);
+
+    /* Register the parallel transpose functions run by par-trans */
+    registerParTransFunction(transpose_parallel, transpose_parallel_desc);
 
 }
 
@@ -0,0 +1,269 @@
+#include <err.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "cachelab.h"
+#include "memtrace.h"
+#include "utils.h"
+
+/* Same bounds as test-trans */
+#define MAXN 256
+#define MAX_BLOCK_SIZE 32
+
+#define ORDER_COUNT 4
+
+typedef struct s_option {
+    size_t E, b, s;
+    const char *o;
+} t_option;
+
+typedef struct s_result {
+    trans_tuning_t tuning;
+    size_t misses;
+} t_result;
+
+static const char *usage_format =
+    "Usage: %s [-h] [-s <num> -E <num> -b <num>] [-o <file>] <M>x<N>...\n"
+    "Options:\n"
+    "  -h         Print this help message.\n"
+    "  -s <num>   Number of set index bits (default: 5).\n"
+    "  -E <num>   Number of lines per set (default: 1).\n"
+    "  -b <num>   Number of block offset bits (default: 5).\n"
+    "  -o <file>  Write the table to a file instead of stdout.\n"
+    "\n"
+    "Examples:\n"
+    "  linux>  %s 32x32 64x64 61x67\n"
+    "  linux>  %s -s 6 -E 4 -b 6 -o trans-tune.h 128x128\n";
+
+/* Defined in the instrumented build of trans.c */
+extern void registerFunctions();
+extern char transpose_tuned_desc[];
+extern trans_tuning_t trans_tunings[MAX_TRANS_TUNINGS];
+int is_transpose(int M, int N, int A[N][M], int B[M][N]);
+
+/* Defined in cachelab.c */
+extern trans_func_t func_list[MAX_TRANS_FUNCS];
+extern int func_counter;
+
+/* Laid out as in test-trans: the markers, the matrices one cache size
+   apart, then the sizes that the call to a function loads */
+volatile char MARKER_START, MARKER_END;
+static int A[MAXN][MAXN];
+static int B[MAXN][MAXN];
+static int M, N;
+
+static size_t count_misses(const t_option *option, int tuned,
+                           const trans_tuning_t *table, size_t i);
+static int find_tuned(void);
+static void parse_arguments(int argc, char *const argv[], t_option *option);
+static void parse_shape(const char *program_name, const char *arg,
+                        trans_tuning_t *tuning);
+static void print_table(FILE *stream, int argc, char *const argv[],
+                        const t_result *results, size_t length);
+static void print_usage_and_exit(const char *program_name, int exit_code);
+static void tune_shape(const t_option *option, int tuned,
+                       trans_tuning_t *table, size_t i, t_result *result);
+
+int main(int argc, char *argv[]) {
+    t_option option = {0};
+    t_result *results;
+    size_t i, length;
+    FILE *stream = stdout;
+    int tuned;
+
+    parse_arguments(argc, argv, &option);
+    registerFunctions();
+    tuned = find_tuned();
+    length = argc - optind;
+    if (length >= MAX_TRANS_TUNINGS)
+        errx(EXIT_FAILURE, "At most %d shapes fit trans-tune.h",
+             MAX_TRANS_TUNINGS - 1);
+    results = safe_calloc(length, sizeof(t_result));
+    /* The candidates are tried in the table the tuned transpose reads, so
+       it is emptied of the shapes trans.c was built with */
+    memset(trans_tunings, 0, MAX_TRANS_TUNINGS * sizeof(trans_tuning_t));
+    for (i = 0; i < length; i++) {
+        parse_shape(argv[0], argv[optind + i], &results[i].tuning);
+        tune_shape(&option, tuned, trans_tunings, i, &results[i]);
+    }
+    /* Only replace the table once every shape has been tuned. */
+    if (option.o)
+        stream = safe_fopen(option.o, "w");
+    print_table(stream, argc, argv, results, length);
+    if (stream != stdout && fclose(stream))
+        err(EXIT_FAILURE, "%s", option.o);
+    safe_free((void **)&results);
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Runs the tuned transpose of the instrumented trans.c with the candidate
+ * at table[i], after the shapes tuned before it, and simulates what it
+ * touched. The marker stores and the loads that call the function are
+ * recorded, and the stack left out, as test-trans does, so the counts
+ * match what test-trans reports for the generated table.
+ */
+static size_t count_misses(const t_option *option, int tuned,
+                           const trans_tuning_t *table, size_t i) {
+    const trans_tuning_t *tuning = &table[i];
+    t_memtrace trace = {0};
+    t_count count = {0};
+    t_cache cache;
+    size_t j;
+
+    M = tuning->M;
+    N = tuning->N;
+    initMatrix(M, N, A, B);
+    start_memtrace(&trace);
+    record_access('S', &MARKER_START, 1);
+    record_access('L', &func_list[tuned].typed_ptr, 8);
+    record_access('L', &func_list[tuned].inplace_ptr, 8);
+    record_access('L', &func_list[tuned].func_ptr, 8);
+    record_access('L', &M, 4);
+    record_access('L', &N, 4);
+    (*func_list[tuned].func_ptr)(M, N, A, B);
+    record_access('S', &MARKER_END, 1);
+    stop_memtrace();
+    if (!is_transpose(M, N, A, B))
+        errx(EXIT_FAILURE, "%dx%d blocks of %dx%d: wrong transpose",
+             tuning->rows, tuning->cols, M, N);
+    init_cache(&cache, option->s, option->E, option->b);
+    for (j = 0; j < trace.length; j++) {
+        if (!is_stack_access(&trace, &trace.records[j]))
+            access_memory(trace.records[j].address, &cache, &count);
+    }
+    free_cache(&cache);
+    free_memtrace(&trace);
+    return count.miss;
+}
+
+/*
+ * Finds the tuned transpose among the registered functions.
+ */
+static int find_tuned(void) {
+    int i;
+
+    for (i = 0; i < func_counter; i++) {
+        if (func_list[i].description == transpose_tuned_desc)
+            return i;
+    }
+    errx(EXIT_FAILURE, "The tuned transpose is not registered");
+}
+
+static void parse_arguments(int argc, char *const argv[], t_option *option) {
+    const char *program_name = argv[0];
+    int opt;
+
+    option->s = 5;
+    option->E = 1;
+    option->b = 5;
+    while ((opt = getopt(argc, argv, "hs:E:b:o:")) != -1) {
+        switch (opt) {
+        case 'h':
+            print_usage_and_exit(program_name, EXIT_SUCCESS);
+        case 's':
+            option->s = atoi(optarg);
+            break;
+        case 'E':
+            option->E = atoi(optarg);
+            break;
+        case 'b':
+            option->b = atoi(optarg);
+            break;
+        case 'o':
+            option->o = optarg;
+            break;
+        default:
+            print_usage_and_exit(program_name, EXIT_FAILURE);
+        }
+    }
+    if (option->s <= 0 || option->E <= 0 || option->b <= 0 || optind >= argc) {
+        fprintf(stderr, "%s: Missing required command line argument\n",
+                program_name);
+        print_usage_and_exit(program_name, EXIT_FAILURE);
+    }
+}
+
+static void parse_shape(const char *program_name, const char *arg,
+                        trans_tuning_t *tuning) {
+    char rest;
+
+    if (sscanf(arg, "%dx%d%c", &tuning->M, &tuning->N, &rest) != 2 ||
+        tuning->M <= 0 || tuning->N <= 0 || tuning->M > MAXN ||
+        tuning->N > MAXN) {
+        fprintf(stderr, "%s: Invalid shape %s\n", program_name, arg);
+        print_usage_and_exit(program_name, EXIT_FAILURE);
+    }
+}
+
+static void print_table(FILE *stream, int argc, char *const argv[],
+                        const t_result *results, size_t length) {
+    const trans_tuning_t *tuning;
+    size_t i;
+    int j;
+
+    fprintf(stream, "/*\n"
+                    " * trans-tune.h - Blockings picked by tune-trans; "
+                    "regenerate with make tune\n"
+                    " *\n"
+                    " * Generated by:");
+    for (j = 0; j < argc; j++)
+        fprintf(stream, " %s", argv[j]);
+    fprintf(stream, "\n */\n"
+                    "trans_tuning_t trans_tunings[MAX_TRANS_TUNINGS] = {\n"
+                    "    /* M, N, rows, cols, order, diagonal */\n");
+    for (i = 0; i < length; i++) {
+        tuning = &results[i].tuning;
+        fprintf(stream, "    {%d, %d, %d, %d, %d, %d}, /* %zu misses */\n",
+                tuning->M, tuning->N, tuning->rows, tuning->cols,
+                tuning->order, tuning->diagonal, results[i].misses);
+    }
+    fprintf(stream, "    {0}\n"
+                    "};\n");
+}
+
+static void print_usage_and_exit(const char *program_name, int exit_code) {
+    FILE *stream = exit_code == EXIT_SUCCESS ? stdout : stderr;
+
+    fprintf(stream, usage_format, program_name, program_name, program_name);
+    exit(exit_code);
+}
+
+/*
+ * Tries every block shape up to MAX_BLOCK_SIZE on a side, in each loop
+ * order, with and without the diagonal held back. Ties go to the first
+ * candidate found, so smaller blocks win.
+ */
+static void tune_shape(const t_option *option, int tuned,
+                       trans_tuning_t *table, size_t i, t_result *result) {
+    trans_tuning_t *candidate = &table[i];
+    size_t misses;
+
+    *candidate = result->tuning;
+    result->misses = SIZE_MAX;
+    for (candidate->rows = 1; candidate->rows <= MAX_BLOCK_SIZE;
+         candidate->rows++) {
+        for (candidate->cols = 1; candidate->cols <= MAX_BLOCK_SIZE;
+             candidate->cols++) {
+            for (candidate->order = 0; candidate->order < ORDER_COUNT;
+                 candidate->order++) {
+                for (candidate->diagonal = 0; candidate->diagonal <= 1;
+                     candidate->diagonal++) {
+                    misses = count_misses(option, tuned, table, i);
+                    if (misses < result->misses) {
+                        result->tuning = *candidate;
+                        result->misses = misses;
+                    }
+                }
+            }
+        }
+    }
+    *candidate = result->tuning;
+    fprintf(stderr, "%dx%d: %dx%d blocks, order %d, diagonal %d: %zu misses\n",
+            result->tuning.M, result->tuning.N, result->tuning.rows,
+            result->tuning.cols, result->tuning.order, result->tuning.diagonal,
+            result->misses);
+}
@@ -23,3 +23,10 @@ void safe_free(void **pp) {
     free(*pp);
     *pp = NULL;
 }
+
+void *safe_realloc(void *ptr, size_t size) {
+    void *p = realloc(ptr, size);
+    if (!p)
+        err(EXIT_FAILURE, "realloc()");
+    return p;
+}
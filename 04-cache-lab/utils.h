@@ -6,5 +6,6 @@
 void *safe_calloc(size_t nmemb, size_t size);
 FILE *safe_fopen(const char *pathname, const char *mode);
 void safe_free(void **pp);
+void *safe_realloc(void *ptr, size_t size);
 
 #endif